@@ -0,0 +1,151 @@
+// Main loop time of blocking ADC reads against the adc ring.
+//
+// Times the old potentiometer read, three single conversions waiting on
+// ADSC, and a drain of the free running adc ring that averages what
+// arrived since the previous call 1 ms earlier, both in cycles with
+// timer1 at F_CPU.
+// Then counts the iterations of an empty loop during one timer1
+// overflow with the adc interrupt off and on, which gives the share of
+// the CPU the interrupt takes. Reports on the serial port:
+//
+//   blocking <cycles per call>
+//   ring <cycles per call> <samples per call>
+//   isr <permille of the cpu>
+//
+// Needs a voltage on ADC0, a potentiometer will do.
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include <util/delay.h>
+#include <stdlib.h>
+
+#include "usart.h"
+#include "adc.h"
+
+enum { CHANNEL = 0, N_READINGS = 3, N_RUNS = 16 };
+
+static const adc_channel_t channels[] PROGMEM = {
+    { ADC_REF_AVCC | CHANNEL, 1, ADC_STREAM },
+};
+
+static uint16_t blocking_read(void)
+{
+    uint16_t raw = 0;
+
+    for (uint8_t i = 0; i < N_READINGS; i++) {
+        ADCSRA |= _BV(ADSC);
+        loop_until_bit_is_clear(ADCSRA, ADSC);
+        raw += ADC;
+    }
+
+    return raw / N_READINGS;
+}
+
+static uint8_t samples;
+
+static uint16_t ring_read(void)
+{
+    uint16_t raw = 0;
+    uint8_t n = 0;
+    int sample;
+
+    while ((sample = adc_read()) >= 0) {
+        raw += sample;
+        n++;
+    }
+    samples = n;
+
+    return n ? raw / n : 0;
+}
+
+static uint16_t measure(uint16_t (*read)(void))
+{
+    uint16_t t0, t1;
+
+    t0 = TCNT1;
+    read();
+    t1 = TCNT1;
+
+    return t1 - t0;
+}
+
+// empty loop iterations until timer1 overflows
+static uint32_t spin(void)
+{
+    uint32_t n = 0;
+
+    cli();
+    TCNT1 = 0;
+    TIFR1 = _BV(TOV1);
+    sei();
+    while (!(TIFR1 & _BV(TOV1)))
+        n++;
+
+    return n;
+}
+
+static void put(char c)
+{
+    while (!usart_write(c))
+        ;
+}
+
+static void put_string(const char *s)
+{
+    while (*s)
+        put(*s++);
+}
+
+static void put_number(long v)
+{
+    char buf[12];
+
+    put(' ');
+    put_string(ltoa(v, buf, 10));
+}
+
+int main(void)
+{
+    uint32_t blocking = 0, ring = 0, n = 0;
+    uint32_t idle, busy;
+
+    // timer1 normal mode, no prescaler, one tick per cycle
+    TCCR1A = 0;
+    TCCR1B = _BV(CS10);
+
+    setup_usart();
+    sei();
+
+    // single conversions, AVCC reference, prescaler /128
+    ADMUX = _BV(REFS0) | CHANNEL;
+    ADCSRA = _BV(ADEN) | _BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0);
+    for (uint8_t i = 0; i < N_RUNS; i++)
+        blocking += measure(blocking_read);
+
+    ADCSRA = 0;
+    idle = spin();
+
+    setup_adc(channels, 1);
+    for (uint8_t i = 0; i < N_RUNS; i++) {
+        _delay_ms(1);
+        ring += measure(ring_read);
+        n += samples;
+    }
+
+    busy = spin();
+
+    put_string("blocking");
+    put_number(blocking / N_RUNS);
+    put_string("\r\nring");
+    put_number(ring / N_RUNS);
+    put_number(n / N_RUNS);
+    put_string("\r\nisr");
+    put_number(1000 - busy * 1000 / idle);
+    put_string("\r\n");
+
+    for (;;)
+        ;
+
+    return 0;
+}
@@ -1,6 +1,10 @@
 #include <avr/io.h>
 #include <util/delay.h>
 
+#include "pin.h"
+
+#define LED (OUT, B, PB0)
+
 static const int DELAY_SHORT = 100;
 static const int DELAY = 500;
 
@@ -9,15 +13,15 @@ int main(void)
 {
     int n = 10;
 
-    DDRB |= _BV(PB0);
+    PIN_INIT(LED);
 
     while (n-- > 0) {
-	PORTB ^= _BV(PB0);
+	PIN_TOGGLE(LED);
 	_delay_ms(DELAY_SHORT);
     }
 
     for (;;) {
-	PORTB ^= _BV(PB0);
+	PIN_TOGGLE(LED);
 	_delay_ms(DELAY);
     }
 
@@ -1,8 +1,15 @@
 #include <avr/io.h>
 #include <avr/interrupt.h>
+#include <avr/pgmspace.h>
 #include <util/delay.h>
 
+#include "adc.h"
+#include "ticks.h"
+#include "display.h"
+#include "filter.h"
+#include "idle.h"
 #include "timer0.h"
+#include "timerwheel.h"
 
 //                           +-\/-+
 //               reset PC6  1|    |28  PC5 display cathode 3
@@ -21,182 +28,74 @@
 //       push button 1 PB0 14|    |15  PB1 OC1A pwm output
 //                           +----+
 
-#if F_CPU == 1000000
-  #define TIMER2_PRESCALE 8
-#elif F_CPU == 8000000 || F_CPU == 16000000
-  #define TIMER2_PRESCALE 64
-#else
-  #error F_CPU not recognized
-#endif
+// display refresh interrupt, prescaler and TOP from timer2conf.h
+#define TIMER2_PERIOD_US DISPLAY_SLOT_US
+#include "timer2conf.h"
 
 enum {
-    TIMER2_RESET_TO_400_MICROS = 256 - (F_CPU / TIMER2_PRESCALE / 2500),
-
     PIN_LED = PB2,
     PIN_BUTTON1 = PB0,
     PIN_BUTTON2 = PD7,
 
-    PIN_CATHODE_DIGIT_0 = PC2,
-    PIN_CATHODE_DIGIT_1 = PC3,
-    PIN_CATHODE_DIGIT_2 = PC4,
-    PIN_CATHODE_DIGIT_3 = PC5,
-    PIN_CATHODES_MASK = (_BV(PIN_CATHODE_DIGIT_0) | _BV(PIN_CATHODE_DIGIT_1) |
-                         _BV(PIN_CATHODE_DIGIT_2) | _BV(PIN_CATHODE_DIGIT_3)),
-
-    PIN_ANODE_SEG_A = PD0,
-    PIN_ANODE_SEG_B = PD1,
-    PIN_ANODE_SEG_C = PD2,
-    PIN_ANODE_SEG_D = PD3,
-    PIN_ANODE_SEG_E = PD4,
-    PIN_ANODE_SEG_F = PD5,
-    PIN_ANODE_SEG_G = PD6,
-    PIN_ANODES_MASK = (_BV(PIN_ANODE_SEG_A) | _BV(PIN_ANODE_SEG_B) | _BV(PIN_ANODE_SEG_C) |
-                       _BV(PIN_ANODE_SEG_D) | _BV(PIN_ANODE_SEG_E) | _BV(PIN_ANODE_SEG_F) |
-                       _BV(PIN_ANODE_SEG_G))
+    CHANNEL_POTENTIOMETER = 0,
 };
 
-static int segment[] = {
-    0b00111111, // 0
-    0b00000110, // 1
-    0b01011011, // 2
-    0b01001111, // 3
-    0b01100110, // 4
-    0b01101101, // 5
-    0b01111101, // 6
-    0b00000111, // 7
-    0b01111111, // 8
-    0b01101111, // 9
-};
+// potentiometer average over about 2^POT_SHIFT samples
+#define POT_SHIFT 3
 
 typedef struct {
-    uint8_t digits[4];
-    uint8_t digit;
-    uint8_t segment;
-    int value;
-    int on;
-} display_t;
-
-typedef struct {
-    int raw, prevraw;
+    filter_median3_t median;
+    filter_ema_t ema;
+    filter_deadband_t deadband;
+    filter_hold_t hold; // at most one change per 50 ms
     int v;
-    long t;
 } analogvalue_t;
 
 static volatile display_t display;
 
-static void display_update(volatile display_t *d)
-{
-    if (d->on) {
-        // digit
-        uint8_t port_c = PORTC;
-        port_c |= PIN_CATHODES_MASK;
-
-        switch (d->digit) {
-        case 0:
-            port_c &= ~_BV(PIN_CATHODE_DIGIT_0);
-            break;
-        case 1:
-            if (d->digits[1] != 0)
-                port_c &= ~_BV(PIN_CATHODE_DIGIT_1);
-            break;
-        case 2:
-            if (d->digits[2] != 0)
-                port_c &= ~_BV(PIN_CATHODE_DIGIT_2);
-            break;
-        case 3:
-            if (d->digits[3] != 0)
-                port_c &= ~_BV(PIN_CATHODE_DIGIT_3);
-            break;
-        }
-
-        PORTC = port_c;
-
-        // segment
-        int value = d->digits[d->digit];
-        uint8_t port_d = (PORTD & _BV(PD7));
-        PORTD = (segment[value] & _BV(d->segment)) | port_d;
-
-        if (++d->segment == 7) {
-            d->segment = 0;
-            if (++d->digit == 4)
-                d->digit = 0;
-        }
-    }
-}
-
-static void display_on(volatile display_t *d, int on)
-{
-    cli();
-    d->on = on;
-    sei();
-}
-
-static void display_off(volatile display_t *d)
-{
-    display_on(d, 0);
-}
-
-void display_toggle(volatile display_t *d)
-{
-    cli();
-    d->on = !d->on;
-    if (!d->on)
-        display_off(d);
-    sei();
-}
+static const adc_channel_t channels[] PROGMEM = {
+    // potentiometer samples arrive in the adc ring, oversampled to 12 bits
+    { ADC_REF_AVCC | CHANNEL_POTENTIOMETER, 1, ADC_STREAM | ADC_BITS(12) },
+};
 
-static void display_set(volatile display_t *d, int value)
+ISR(TIMER2_COMPA_vect)
 {
-    d->digits[0] = value % 10;
-    d->digits[1] = (value / 10) % 10;
-    d->digits[2] = (value / 100) % 10;
-    d->digits[3] = (value / 1000) % 10;
-    d->value = value;
+    // timer2 clears on compare match every DISPLAY_SLOT_US microseconds
+    display_update(&display);
 }
 
-ISR(TIMER2_OVF_vect)
+#ifdef DISPLAY_LEVELS
+ISR(TIMER2_COMPB_vect)
 {
-    // timer interrupt overflows every 400 microseconds
-    TCNT2 = TIMER2_RESET_TO_400_MICROS;
-    display_update(&display);
+    // end of the lit part of the slot
+    display_blank();
 }
+#endif
 
 void setup_timer2(void)
 {
-#if F_CPU == 8000000
-    // prescale /32
-    TCCR2A = 0;
-    TCCR2B = _BV(CS21) | _BV(CS20);
-#elif F_CPU == 16000000
-    // prescale /64
-    TCCR2A = 0;
-    TCCR2B = _BV(CS22);
-#else
-#error F_CPU not recognized
+    // CTC mode, clear on compare match with OCR2A
+    TCCR2A = _BV(WGM21);
+    TCCR2B = TIMER2_CS_BITS;
+    OCR2A = TIMER2_TOP;
+    TCNT2 = 0;
+
+    // compare match a interrupt enable
+    TIMSK2 |= _BV(OCIE2A);
+#ifdef DISPLAY_LEVELS
+    // compare match b interrupt enable, dims the display
+    TIMSK2 |= _BV(OCIE2B);
 #endif
 
-    // overflow interrupt enable
-    TIMSK2 |= _BV(TOIE2);
-    TCNT2 = TIMER2_RESET_TO_400_MICROS;
-
     sei();
 }
 
 void setup(void)
 {
-    // turn rx/tx on PD0 and PD1 off
-    UCSR0B = 0;
-
-    // display anodes PD0 .. PD6
-    DDRD = PIN_ANODES_MASK;
-
-    // display cathodes
-    DDRC = PIN_CATHODES_MASK;
-    PORTC |= PIN_CATHODES_MASK;
+    setup_display(&display);
 
-    // Set ADC prescaler /128, 16 Mhz / 128 = 125 KHz which is inside
-    // the desired 50-200 KHz range
-    ADCSRA = _BV(ADEN) | _BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0);
+    // potentiometer samples arrive in the adc ring
+    setup_adc(channels, 1);
 
     // LED pin
     DDRB |= _BV(PIN_LED);
@@ -205,75 +104,42 @@ void setup(void)
 
 void analog_init(analogvalue_t *value)
 {
-    value->raw = 0;
-    value->prevraw = 0;
-    value->v = 0;
-    value->t = millis();
-}
-
-int analog_read(int chan, analogvalue_t *value)
-{
-    uint8_t low, high;
-
-    // AVCC with external capacitor at AREF pin, select channel
-    ADMUX = (_BV(REFS0) | (chan & 0x0f));
-
-    // start single conversion
-    ADCSRA |= _BV(ADSC);
-
-    // wait for conversion to complete
-    loop_until_bit_is_clear(ADCSRA, ADSC);
-
-    low  = ADCL;
-    high = ADCH;
-
-    value->raw = (high << 8) | low;
-    value->t = millis();
-
-    return value->raw;
+    *value = (analogvalue_t){ 0 };
+    value->hold.t = millis();
 }
 
 int potentiometer_read(analogvalue_t *value)
 {
-    analogvalue_t newvalue;
-    enum { CHANNEL = 0, N_READINGS = 3 };
+    uint16_t raw = value->ema.acc >> POT_SHIFT;
+    int sample;
 
-    int raw = 0;
-    for (int i = 0; i < N_READINGS; i++) {
-        analog_read(CHANNEL, &newvalue);
-        raw += newvalue.raw;
-    }
+    // filter what the adc interrupt collected since the last call
+    while ((sample = adc_read()) >= 0)
+        raw = filter_ema(&value->ema, filter_median3(&value->median, sample), POT_SHIFT);
 
-    newvalue.raw = raw / N_READINGS;
-    if (newvalue.raw > 1020)
-        newvalue.raw = 1020;
-
-    if ((newvalue.raw > value->prevraw && newvalue.raw - value->prevraw > 3) ||
-        (newvalue.raw < value->prevraw && value->prevraw - newvalue.raw > 3)) {
-
-        if (newvalue.t - value->t > 50) {
-            value->prevraw = value->raw;
-            value->raw = newvalue.raw;
-            value->v = newvalue.raw / 4;
-            value->t = newvalue.t;
-        }
-    }
+    // 12 bits, the delay in ms takes 10 of them
+    if (raw > 4080)
+        raw = 4080;
+    raw = filter_deadband(&value->deadband, raw, 4, 4080);
+    raw = filter_hold(&value->hold, raw, millis(), 50);
+    value->v = raw / 4;
 
     return value->v;
 }
 
 void settle_on_low(volatile uint8_t *port, uint8_t mask)
 {
-    long t = 0, t0 = 0;
-    enum { SETTLE_ON_LOW_TIMEOUT_MS = 20 };
+    uint16_t t0;
+    enum { SETTLE_ON_LOW_TIMEOUT_US = 20000 };
 
     loop_until_bit_is_clear(*port, mask);
-    t0 = millis();
+    t0 = ticks16();
 
-    // now wait for pin to stay low for at least x milliseconds
-    while ((t = millis()) - t0 < SETTLE_ON_LOW_TIMEOUT_MS) {
+    // now wait for pin to stay low for at least x milliseconds, well
+    // inside the 32 ms the 16 bit tick takes to wrap
+    while ((uint16_t)(ticks16() - t0) < US_TO_TICKS(SETTLE_ON_LOW_TIMEOUT_US)) {
 	if (bit_is_set(*port, mask))
-	    t0 = millis();
+	    t0 = ticks16();
     }
 }
 
@@ -304,12 +170,22 @@ void disable_int0()
 /*     t0 = micros(); */
 /* } */
 
-int main(void)
+static analogvalue_t delay;
+
+static void poll_potentiometer(void)
 {
-    analogvalue_t delay;
+    potentiometer_read(&delay);
+    if (delay.v != display.value) {
+        display_set(&display, delay.v);
+    }
+}
 
+int main(void)
+{
     setup();
     setup_timer0();
+    setup_ticks();
+    setup_idle();
 
     // setup_int0();
 
@@ -322,6 +198,9 @@ int main(void)
     display_set(&display, delay.v);
     display_on(&display, 1);
 
+    timerwheel_init();
+    timerwheel_start(TIMER0_MS_TO_TICKS(10), TIMER0_MS_TO_TICKS(10), poll_potentiometer);
+
     /* if ((PIND & _BV(PIN_SW1)) == 0) */
     /*     pin = PIN_LED_RED; */
 
@@ -352,10 +231,8 @@ int main(void)
         }
 */
 
-        potentiometer_read(&delay);
-        if (delay.v != display.value) {
-            display_set(&display, delay.v);
-        }
+        timerwheel_run();
+        idle();
     }
 
     return 0;
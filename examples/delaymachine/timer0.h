@@ -1,8 +0,0 @@
-//
-// timer.h
-//
-
-void setup_timer0(void);
-
-unsigned long millis(void);
-unsigned long micros(void);
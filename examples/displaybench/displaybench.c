@@ -0,0 +1,230 @@
+// Cycle benchmark for display_set(), no display needed.
+//
+// Times display_set() against the former % and / implementation for
+// every value 0 .. DISPLAY_MAX with timer1 running at F_CPU, and reports
+// min, max and average cycles per call on the serial port:
+//
+//   divmod  min max avg
+//   convert min max avg
+//   step    min max avg
+//
+// "step" counts up and then down through the whole range, so every call
+// takes the +1/-1 path. The call overhead measured with an empty
+// function is subtracted.
+//
+// Then display_update() runs from the timer2 compare interrupt with
+// timer2 undivided, so TCNT2 at the OCR2B store counts the cycles since
+// the compare match, and the bench reports them:
+//
+//   store   min max
+//
+// Set DISPLAY_STORE_CYCLES in display.c to the max.
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "usart.h"
+#include "display.h"
+
+typedef struct {
+    uint16_t min;
+    uint16_t max;
+    uint32_t sum;
+    uint16_t n;
+} stats_t;
+
+static volatile display_t display;
+static uint16_t overhead;
+static volatile uint8_t store_min = 0xff, store_max;
+static volatile uint16_t updates;
+
+ISR(TIMER2_COMPA_vect)
+{
+    display_update(&display);
+
+    uint8_t t = display_store_ticks;
+    if (t < store_min)
+        store_min = t;
+    if (t > store_max)
+        store_max = t;
+    updates++;
+}
+
+static const uint8_t segment[] = {
+    0b00111111, // 0
+    0b00000110, // 1
+    0b01011011, // 2
+    0b01001111, // 3
+    0b01100110, // 4
+    0b01101101, // 5
+    0b01111101, // 6
+    0b00000111, // 7
+    0b01111111, // 8
+    0b01101111, // 9
+};
+
+// display_set() as it was before the bcd conversion
+__attribute__((noinline))
+static void divmod_set(volatile display_t *d, int value)
+{
+    uint8_t fb[4];
+    int v = value;
+
+    fb[0] = segment[v % 10];
+    fb[1] = segment[(v / 10) % 10];
+    fb[2] = segment[(v / 100) % 10];
+    fb[3] = segment[(v / 1000) % 10];
+
+    if (v < 1000) {
+        fb[3] = 0;
+        if (v < 100) {
+            fb[2] = 0;
+            if (v < 10)
+                fb[1] = 0;
+        }
+    }
+
+    for (uint8_t i = 0; i < 4; i++)
+        d->fb[0][i] = fb[i];
+    d->value = value;
+}
+
+__attribute__((noinline))
+static void empty_set(volatile display_t *d, int value)
+{
+    __asm__ volatile ("");
+}
+
+static uint16_t measure(void (*set)(volatile display_t *, int), int value)
+{
+    uint16_t t0, t1;
+
+    cli();
+    t0 = TCNT1;
+    set(&display, value);
+    t1 = TCNT1;
+    sei();
+
+    return t1 - t0;
+}
+
+static void stats_init(stats_t *s)
+{
+    s->min = 0xffff;
+    s->max = 0;
+    s->sum = 0;
+    s->n = 0;
+}
+
+static void stats_add(stats_t *s, uint16_t cycles)
+{
+    cycles -= overhead;
+    if (cycles < s->min)
+        s->min = cycles;
+    if (cycles > s->max)
+        s->max = cycles;
+    s->sum += cycles;
+    s->n++;
+}
+
+static void put(char c)
+{
+    while (!usart_write(c))
+        ;
+}
+
+static void put_string(const char *s)
+{
+    while (*s)
+        put(*s++);
+}
+
+static void put_decimal(uint32_t v)
+{
+    char buf[11];
+    uint8_t i = 0;
+
+    do {
+        buf[i++] = '0' + v % 10;
+        v /= 10;
+    } while (v);
+
+    while (i)
+        put(buf[--i]);
+}
+
+static void report(const char *name, const stats_t *s)
+{
+    put_string(name);
+    put(' ');
+    put_decimal(s->min);
+    put(' ');
+    put_decimal(s->max);
+    put(' ');
+    put_decimal(s->sum / s->n);
+    put_string("\r\n");
+}
+
+int main(void)
+{
+    stats_t s;
+
+    // timer1 normal mode, no prescaler, one tick per cycle
+    TCCR1A = 0;
+    TCCR1B = _BV(CS10);
+
+    setup_usart();
+    sei();
+
+    overhead = measure(empty_set, 0);
+
+    stats_init(&s);
+    for (int v = 0; v <= DISPLAY_MAX; v++)
+        stats_add(&s, measure(divmod_set, v));
+    report("divmod ", &s);
+
+    stats_init(&s);
+    for (int v = 0; v <= DISPLAY_MAX; v++) {
+        display.value = DISPLAY_NONE; // never a +1/-1 step
+        stats_add(&s, measure(display_set, v));
+    }
+    report("convert", &s);
+
+    stats_init(&s);
+    display_set(&display, 0);
+    for (int v = 1; v <= DISPLAY_MAX; v++)
+        stats_add(&s, measure(display_set, v));
+    for (int v = DISPLAY_MAX - 1; v >= 0; v--)
+        stats_add(&s, measure(display_set, v));
+    report("step   ", &s);
+
+    // wait for the report to go out, the usart interrupt would delay
+    // the refresh
+    while (usart_tx_free() < USART_TX_BUFFER_SIZE - 1)
+        ;
+
+    // 256 cycle slots, a text scrolled so frame boundaries take the
+    // longest path
+    display_text(&display, "displaybench");
+    display_on(&display, 1);
+    TCCR2A = _BV(WGM21);
+    OCR2A = 255;
+    TCNT2 = 0;
+    TCCR2B = _BV(CS20);
+    TIMSK2 = _BV(OCIE2A);
+    while (updates < 10000)
+        ;
+    TIMSK2 = 0;
+    display_off(&display);
+
+    put_string("store   ");
+    put_decimal(store_min);
+    put(' ');
+    put_decimal(store_max);
+    put_string("\r\n");
+
+    for (;;)
+        ;
+
+    return 0;
+}
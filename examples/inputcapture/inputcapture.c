@@ -1,177 +1,184 @@
 #include <avr/io.h>
 #include <avr/interrupt.h>
-#include <util/delay.h>
 
-#define TIMER1_CLKFUDGE 3
-#define TIMER1_GETVALUE(x) ((x) >> 1)
+#include "capture.h"
+#include "idle.h"
+#include "pin.h"
+#include "telemetry.h"
+#include "timer0.h"
+#include "timerwheel.h"
+#include "usart.h"
 
-#define TIMER2_PRESCALE_DIVIDER 1024
+// 61.0 Hz at 16 MHz, prescaler /1024
+#define TIMER2_PWM_HZ 61
+#include "timer2conf.h"
 
 #define PULSEWIDTH_MARGIN 10
 
-// set by TIMER1_CAPT_vect interrupt routine
-volatile uint16_t pulsewidth = 0;
+// outputs off after 3 frames of 20 ms without a 900..2100 us pulse
+static capture_failsafe_t failsafe = {
+    .min = US_TO_TICKS(900), .max = US_TO_TICKS(2100),
+    .frames = 3, .frame_ms = 20,
+};
 
-void setup_usart(void)
-{
-#ifndef BAUD
-#define BAUD 57600
-#endif
-#include <util/setbaud.h>
-    UBRR0H = UBRRH_VALUE; // from setbaud.h
-    UBRR0L = UBRRL_VALUE;
-#if USE_2X
-    UCSR0A |= _BV(U2X0);
-#else
-    UCSR0A &= ~_BV(U2X0);
-#endif
-    // enable tx and rx
-    UCSR0B = _BV(TXEN0) | _BV(RXEN0);
-    // 8 data bits
-    UCSR0C = _BV(UCSZ01) | _BV(UCSZ00);
-}
+// RC input on ICP1 (PB0), the debug led on PB2 follows it, see the
+// Makefile
+#define PWM_OUTPUT (OUT, B, PB3) // OC2A
 
-void sendbyte(uint8_t data)
+void setup_timer2(void)
 {
-    loop_until_bit_is_set(UCSR0A, UDRE0);
-    UDR0 = data;
-}
+    PIN_INIT(PWM_OUTPUT);
 
-void sendstring(const char *s)
-{
-    if (s) {
-        while (*s != '\0')
-            sendbyte(*s++);
-    }
-}
+    TCCR2A = 0;
+    TCCR2B = TIMER2_CS_BITS;
 
-char tohex(uint8_t nibble) 
-{
-    return nibble < 10
-        ? '0' + nibble
-        : 'A' + nibble - 10;
+    // fast pwm mode 3
+    TCCR2A |= _BV(WGM21) | _BV(WGM20);
+    TCCR2B &= ~_BV(WGM22);
 }
 
-void sendhexbyte(uint8_t byte)
+void timer2_set_oc2a(uint8_t ocr2a)
 {
-    sendbyte(tohex((byte & 0xf0) >> 4));
-    sendbyte(tohex(byte & 0x0f));
+    if (ocr2a) {
+        // clear OC2A on compare match (non-inverting mode)
+        TCCR2A |= _BV(COM2A1);
+        TCCR2A &= ~_BV(COM2A0);
+        OCR2A = ocr2a;
+    } else {
+        // OC2A disconnected
+        TCCR2A &= ~(_BV(COM2A1) | _BV(COM2A0));
+    }
 }
 
-void sendhexword(uint16_t word)
+static long map(int x, long in_min, long in_max, long out_min, long out_max)
 {
-    sendhexbyte((word & 0xff00) >> 8);
-    sendhexbyte(word & 0xff);
-    sendbyte('\r');
+    return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
 }
 
-ISR(TIMER1_CAPT_vect)
+static telemetry_t telemetry;
+
+static void telemetry_value(uint8_t type, uint16_t value)
 {
-    uint16_t icr1 = ICR1;
-    TCNT1 = 0;
+    if (!telemetry_add(&telemetry, type, value)) {
+        telemetry_send(&telemetry);
+        telemetry_begin(&telemetry, millis());
+        telemetry_add(&telemetry, type, value);
+    }
 
-    if (bit_is_set(TCCR1B, ICES1)) {
-        // was rising edge -> set to detect falling edge
-        TCCR1B &= ~_BV(ICES1);
-        PORTB = _BV(PB2);
-    } else {
-        pulsewidth = icr1 + TIMER1_CLKFUDGE;
-        // was falling -> now set to detect rising edge
-        TCCR1B |= _BV(ICES1);
-        PORTB &= ~_BV(PB2);
+    if (telemetry_full(&telemetry)) {
+        telemetry_send(&telemetry);
+        telemetry_begin(&telemetry, millis());
     }
 }
 
-void setup(void)
+#ifdef CAPTURE_STATS
+#if CAPTURE_MODE == CAPTURE_CPPM
+#define STATS_CHANNELS CAPTURE_CHANNELS
+#else
+#define STATS_CHANNELS 1
+#endif
+
+// next channel to report, STATS_CHANNELS when done
+static uint8_t stats_next = STATS_CHANNELS;
+
+// One frame per channel, a channel per call so the tx buffer keeps up:
+// channel, n, min, max, mean, variance (saturated), dropped and the
+// histogram, in ticks. Starts the next window of that channel.
+static void report_stats(void)
 {
-    DDRB &= ~_BV(PB0); // ICP1 input pin = PB0
-    DDRB |= _BV(PB2); // debug led
+    capstats_t s;
+    uint32_t var;
+
+    capture_stats(stats_next, &s, 1);
+    var = capstats_variance(&s);
+
+    telemetry_send(&telemetry);
+    telemetry_begin(&telemetry, millis());
+    telemetry_add(&telemetry, TELEMETRY_TYPE_STATS, stats_next);
+    telemetry_add(&telemetry, TELEMETRY_TYPE_STATS, s.n);
+    telemetry_add(&telemetry, TELEMETRY_TYPE_STATS, s.min);
+    telemetry_add(&telemetry, TELEMETRY_TYPE_STATS, s.max);
+    telemetry_add(&telemetry, TELEMETRY_TYPE_STATS, capstats_mean(&s));
+    telemetry_add(&telemetry, TELEMETRY_TYPE_STATS, var > 0xffff ? 0xffff : var);
+    telemetry_add(&telemetry, TELEMETRY_TYPE_STATS, s.dropped);
+    for (uint8_t i = 0; i < CAPSTATS_BINS; i++)
+        telemetry_add(&telemetry, TELEMETRY_TYPE_STATS, s.hist[i]);
+    telemetry_send(&telemetry);
+    telemetry_begin(&telemetry, millis());
+
+    stats_next++;
 }
+#endif
 
-void setup_timer1(void)
+static void report_idle(void)
 {
-    TCCR1A = 0;
-
-    TCCR1B |= _BV(ICES1); // trigger input capture on rising edge
-    TCCR1B |= _BV(CS11);  // set prescaler /8
-
-    TIMSK1 = _BV(ICIE1);  // input capture interrupt enable
+    telemetry_value(TELEMETRY_TYPE_IDLE, idle_permille());
 }
 
-void setup_timer2(void)
+static void sample(void)
 {
-    DDRB |= _BV(PB3); // OC2A pin
-
-    TCCR2A = 0;
-    TCCR2B = 0;
-
-#if F_CPU == 16000000
-#if TIMER2_PRESCALE_DIVIDER == 64
-    // prescale /64
-    TCCR2B |= _BV(CS22);
-    TCCR2B &= ~_BV(CS21);
-    TCCR2B &= ~_BV(CS20);
-#elif TIMER2_PRESCALE_DIVIDER == 256
-    // prescale /256
-    TCCR2B |= _BV(CS22);
-    TCCR2B |= _BV(CS21);
-    TCCR2B &= ~_BV(CS20);
-#elif TIMER2_PRESCALE_DIVIDER == 1024
-    // prescale /1024
-    TCCR2B |= _BV(CS22);
-    TCCR2B |= _BV(CS21);
-    TCCR2B |= _BV(CS20);
-#else
-#error TIMER2_PRESCALE_DIVIDER not set correctly
-#endif
+    capture_t c;
+    uint16_t reading;
+
+    capture_get(&c);
+    reading = TICKS_TO_US(c.width);
+
+#if defined(CAPTURE_STATS)
+    // statistics instead of raw values, requested with an 's'
+    if (stats_next < STATS_CHANNELS)
+        report_stats();
+#elif CAPTURE_MODE == CAPTURE_CPPM
+    // all channels of every new frame, the pwm output follows channel 0
+    static uint8_t last_count;
+    capture_frame_t f;
+
+    capture_frame(&f);
+    if (f.count != last_count) {
+        last_count = f.count;
+        for (uint8_t i = 0; i < f.n; i++)
+            telemetry_value(TELEMETRY_TYPE_PULSEWIDTH, TICKS_TO_US(f.ch[i]));
+    }
 #else
-#error F_CPU not recognized
+    telemetry_value(TELEMETRY_TYPE_PULSEWIDTH, reading);
+    telemetry_value(TELEMETRY_TYPE_PERIOD, TICKS_TO_US(c.period));
+    telemetry_value(TELEMETRY_TYPE_DUTY, capture_duty(&c));
 #endif
 
-    // fast pwm mode 3
-    TCCR2A |= _BV(WGM21) | _BV(WGM20);
-    TCCR2B &= ~_BV(WGM22);
-}
-
-void timer2_set_oc2a(uint8_t ocr2a)
-{
-    if (ocr2a) {
-        // clear OC2A on compare match (non-inverting mode)
-        TCCR2A |= _BV(COM2A1);
-        TCCR2A &= ~_BV(COM2A0);
-        OCR2A = ocr2a;
+    if (capture_failsafe(&failsafe, &c, millis())) {
+        timer2_set_oc2a(0);
+    } else if (reading > 2000 - PULSEWIDTH_MARGIN) {
+        timer2_set_oc2a(0xff);
+    } else if (reading < (1000 + PULSEWIDTH_MARGIN)) {
+        timer2_set_oc2a(0);
     } else {
-        // OC2A disconnected
-        TCCR2A &= ~(_BV(COM2A1) | _BV(COM2A0));
+        timer2_set_oc2a(map(reading, 1000, 2000, 0, 256));
     }
 }
 
-static long map(int x, long in_min, long in_max, long out_min, long out_max)
-{
-    return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
-}
-
 int main(void)
 {
-    setup();
     setup_usart();
-    setup_timer1();
+    setup_timer0();
+    setup_idle();
+    setup_capture();
     setup_timer2();
     sei();
 
+    telemetry_init(&telemetry);
+    telemetry_begin(&telemetry, millis());
+    capture_failsafe_init(&failsafe, millis());
+
+    timerwheel_init();
+    timerwheel_start(TIMER0_MS_TO_TICKS(10), TIMER0_MS_TO_TICKS(10), sample);
+    timerwheel_start(TIMER0_MS_TO_TICKS(1000), TIMER0_MS_TO_TICKS(1000), report_idle);
+
     for (;;) {
-        uint16_t reading = TIMER1_GETVALUE(pulsewidth);
-        sendhexword(reading);
-
-        if (reading > 2000 - PULSEWIDTH_MARGIN) {
-            timer2_set_oc2a(0xff);
-        } else if (reading < (1000 + PULSEWIDTH_MARGIN)) {
-            timer2_set_oc2a(0);
-        } else {
-            timer2_set_oc2a(map(reading, 1000, 2000, 0, 256));
-        }
-
-        _delay_ms(10);
+#ifdef CAPTURE_STATS
+        if (usart_read() == 's')
+            stats_next = 0;
+#endif
+        timerwheel_run();
+        idle();
     }
 
     return 0;
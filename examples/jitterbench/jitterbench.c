@@ -0,0 +1,100 @@
+// Jitter of the display refresh interrupt, no display needed.
+//
+// Runs the display refresh from timer2 as the display examples do, with
+// timer0 (millis) and the usart as competing interrupts, and measures
+// every refresh interrupt with lib/jitter against timer1 running at
+// F_CPU. Once a second the results in cycles go out on the serial port:
+//
+//   ctc n <intervals> min <cycles> max <cycles> mean <cycles>
+//   <deviation> <count>
+//   ...
+//
+// The default build uses CTC mode, "make RELOAD=1" after "make clean"
+// builds the old overflow interrupt that reloads TCNT2 in software. With
+// CTC the mean is 0 and min/max are the latency bound; with the reload
+// the mean shows the drift.
+//
+// In simavr: simavr -m atmega328p -f 16000000 main.elf
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "usart.h"
+#include "display.h"
+#include "timer0.h"
+#include "jitter.h"
+
+#define TIMER2_PERIOD_US DISPLAY_SLOT_US
+#include "timer2conf.h"
+
+static volatile display_t display;
+static volatile jitter_t jitter;
+
+#if REFRESH_RELOAD
+ISR(TIMER2_OVF_vect)
+{
+    jitter_mark(&jitter);
+    TCNT2 = TIMER2_RELOAD;
+    display_update(&display);
+}
+#else
+ISR(TIMER2_COMPA_vect)
+{
+    jitter_mark(&jitter);
+    display_update(&display);
+}
+#endif
+
+static void setup_timer2(void)
+{
+#if REFRESH_RELOAD
+    TCCR2A = 0;
+    TCCR2B = TIMER2_CS_BITS;
+    TCNT2 = TIMER2_RELOAD;
+    TIMSK2 |= _BV(TOIE2);
+#else
+    TCCR2A = _BV(WGM21);
+    TCCR2B = TIMER2_CS_BITS;
+    OCR2A = TIMER2_TOP;
+    TCNT2 = 0;
+    TIMSK2 |= _BV(OCIE2A);
+#endif
+}
+
+static void put(char c)
+{
+    while (!usart_write(c))
+        ;
+}
+
+int main(void)
+{
+    jitter_t j;
+
+    // timer1 normal mode, no prescaler, one tick per cycle
+    TCCR1A = 0;
+    TCCR1B = _BV(CS10);
+
+    jitter_init(&jitter, TIMER2_TICKS * TIMER2_PRESCALE);
+
+    setup_usart();
+    setup_timer0();
+    setup_timer2();
+    sei();
+
+    display_set(&display, 8888);
+    display_on(&display, 1);
+
+    unsigned long t = millis();
+    for (;;) {
+        if (millis() - t < 1000)
+            continue;
+        t += 1000;
+
+        jitter_snapshot(&jitter, &j, 1);
+        usart_write_string(REFRESH_RELOAD ? "reload " : "ctc ");
+        jitter_report(&j, put);
+    }
+
+    return 0;
+}
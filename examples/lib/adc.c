@@ -0,0 +1,194 @@
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+
+#include "critical.h"
+#include "adc.h"
+
+#if ADC_RING_SIZE > 256 || (ADC_RING_SIZE & (ADC_RING_SIZE - 1))
+#error ADC_RING_SIZE must be a power of two <= 256
+#endif
+
+#if ADC_TRIGGER == ADC_TRIGGER_FREE
+// a conversion with the old setting is already under way
+#define IN_FLIGHT 1
+#elif ADC_TRIGGER == ADC_TRIGGER_TIMER0
+#define IN_FLIGHT 0
+#else
+#error ADC_TRIGGER not set correctly
+#endif
+
+#define RING_MASK (ADC_RING_SIZE - 1)
+#define REF_MASK (_BV(REFS1) | _BV(REFS0))
+
+// The head is only written by ADC_vect, the tail only by the main loop.
+// Single byte indices make every access atomic.
+static uint16_t ring[ADC_RING_SIZE];
+static volatile uint8_t head = 0;
+static volatile uint8_t tail = 0;
+
+static volatile uint16_t overflow_count = 0;
+
+// scan state, only touched by ADC_vect after setup_adc()
+static const adc_channel_t *list;
+static uint8_t count;
+static uint8_t current;
+static uint8_t settle;
+static uint8_t countdown[ADC_MAX_CHANNELS];
+
+static volatile uint16_t value[ADC_MAX_CHANNELS];
+
+// oversampling sums and the number of conversions in them
+static uint32_t sum[ADC_MAX_CHANNELS];
+static uint8_t summed[ADC_MAX_CHANNELS];
+
+// Set the multiplexer for channel i, discard while it settles.
+static void select(uint8_t i)
+{
+    uint8_t admux = pgm_read_byte(&list[i].admux);
+    uint8_t old = ADMUX;
+
+    if (admux == old)
+        return;
+
+    ADMUX = admux;
+    settle = IN_FLIGHT + ((admux ^ old) & REF_MASK ? ADC_DISCARD_REF : ADC_DISCARD);
+}
+
+// Slot and ring for a finished result of channel i.
+static inline void store(uint8_t i, uint16_t sample, uint8_t flags)
+{
+    value[i] = sample;
+
+    if (flags & ADC_STREAM) {
+        uint8_t h = head;
+        uint8_t next = (h + 1) & RING_MASK;
+
+        if (next != tail) {
+            ring[h] = sample;
+            head = next;
+        } else {
+            overflow_count++;
+        }
+    }
+}
+
+ISR(ADC_vect)
+{
+    // ADCL first, it locks ADCH until ADCH is read
+    uint16_t sample = ADC;
+    uint8_t i = current;
+    uint8_t flags, extra;
+
+    if (settle) {
+        settle--;
+        return;
+    }
+
+    flags = pgm_read_byte(&list[i].flags);
+    extra = (flags & ADC_BITS_MASK) >> 4;
+    if (extra) {
+        // 4^extra conversions, the counter wraps at 256 for 14 bits
+        uint8_t n = summed[i] + 1;
+
+        summed[i] = n;
+        sum[i] += sample;
+        if ((n & ((1 << (2 * extra)) - 1)) == 0) {
+            // rounded, a plain shift is half an output LSB low
+            store(i, (sum[i] + (1 << (extra - 1))) >> extra, flags);
+            sum[i] = 0;
+        }
+    } else {
+        store(i, sample, flags);
+    }
+
+    // next channel that is due, the first one always is
+    do {
+        if (++i == count)
+            i = 0;
+    } while (i != 0 && --countdown[i] != 0);
+    countdown[i] = pgm_read_byte(&list[i].divider);
+
+    current = i;
+    select(i);
+}
+
+void setup_adc(const adc_channel_t *channels, uint8_t n)
+{
+    if (n > ADC_MAX_CHANNELS)
+        n = ADC_MAX_CHANNELS;
+
+    ADCSRA = 0;
+
+    list = channels;
+    count = n;
+    current = 0;
+    for (uint8_t i = 0; i < n; i++) {
+        uint8_t channel = pgm_read_byte(&channels[i].admux) & 0x0f;
+
+        // every channel once on the first turn
+        countdown[i] = 1;
+        value[i] = 0;
+        sum[i] = 0;
+        summed[i] = 0;
+
+        // no digital input buffer on the analog pins
+        if (channel < 6)
+            DIDR0 |= _BV(channel);
+    }
+
+    ADMUX = pgm_read_byte(&channels[0].admux);
+    settle = ADC_DISCARD_REF;
+
+    ADCSRB = ADC_TRIGGER;
+
+    // Set ADC prescaler /128, 16 Mhz / 128 = 125 KHz which is inside
+    // the desired 50-200 KHz range. Auto trigger, interrupt, and a first
+    // conversion to get free running mode going.
+    ADCSRA = _BV(ADEN) | _BV(ADATE) | _BV(ADIE) |
+        _BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0);
+#if ADC_TRIGGER == ADC_TRIGGER_FREE
+    ADCSRA |= _BV(ADSC);
+#endif
+}
+
+uint16_t adc_value(uint8_t i)
+{
+    uint16_t v;
+    critical_t c = critical_begin();
+
+    v = value[i];
+    critical_end(c);
+
+    return v;
+}
+
+uint8_t adc_available(void)
+{
+    return (head - tail) & RING_MASK;
+}
+
+int adc_read(void)
+{
+    uint8_t t = tail;
+    uint16_t sample;
+
+    if (t == head)
+        return -1;
+
+    sample = ring[t];
+    tail = (t + 1) & RING_MASK;
+
+    return sample;
+}
+
+uint16_t adc_overflows(void)
+{
+    uint16_t n;
+    critical_t c = critical_begin();
+
+    n = overflow_count;
+    critical_end(c);
+
+    return n;
+}
@@ -0,0 +1,109 @@
+//
+// adc.h
+//
+// Interrupt driven ADC scan. The ADC runs in auto trigger mode and
+// ADC_vect walks a list of channels, so nothing ever waits for a
+// conversion. The latest result of every channel is kept in a slot,
+// adc_value() reads it in O(1); results of channels flagged ADC_STREAM
+// also go into a power-of-two ring, adc_read() returns the oldest or -1
+// when the ring is empty. A full ring drops and counts new samples.
+//
+// The channel list lives in PROGMEM, at most ADC_MAX_CHANNELS entries:
+//
+//   static const adc_channel_t channels[] PROGMEM = {
+//       { ADC_REF_AVCC | 0, 1, ADC_STREAM },           // potentiometer
+//       { ADC_REF_AVCC | 1, 4, 0 },                    // current sense
+//       { ADC_REF_AVCC | ADC_MUX_BANDGAP, 64, 0 },     // supply voltage
+//       { ADC_REF_INTERNAL | ADC_MUX_TEMP, 64, 0 },    // temperature
+//   };
+//   setup_adc(channels, 4);
+//
+// A channel with divider d is converted on every d-th turn of the scan,
+// the first channel on every turn. After the multiplexer switches,
+// ADC_DISCARD conversions are thrown away while the sample and hold
+// settles, after a reference switch ADC_DISCARD_REF; free running adds
+// one more for the conversion already under way with the old setting.
+// Consecutive visits to the same setting discard nothing.
+//
+// A channel flagged ADC_BITS(b), b = 11..14, is oversampled: the
+// interrupt adds up 4^(b - 10) conversions and shifts the sum right by
+// b - 10, one result of b bits. That is every 4^(b - 10)-th visit, so the
+// output rate of a channel is the conversion rate / divider / 4^(b - 10),
+// e.g. 61 Hz for 12 bits on timer0. The extra bits are only real if the
+// input has about 1 LSB of noise, which the supply ripple on a
+// breadboard provides. Adds about 25 cycles per oversampled conversion.
+//
+// The sample rate is fixed by the hardware, ADC_TRIGGER selects it:
+//
+//   ADC_TRIGGER_FREE     free running, F_CPU / 128 / 13 (9615 Hz at
+//                        16 MHz) conversions
+//   ADC_TRIGGER_TIMER0   one conversion per timer0 overflow (976 Hz at
+//                        16 MHz), in step with the timerwheel tick
+//
+// The interrupt costs about 70 cycles per conversion, 4 % of the CPU
+// free running and 0.4 % on timer0. A blocking read of three samples
+// took about 5000 cycles (312 us) of the main loop, examples/adcbench
+// compares the two.
+//
+
+#ifndef ADC_H
+#define ADC_H
+
+#include <avr/io.h>
+#include <stdint.h>
+
+#define ADC_TRIGGER_FREE 0
+#define ADC_TRIGGER_TIMER0 4 // ADTS2..0 = 100
+
+#ifndef ADC_TRIGGER
+#define ADC_TRIGGER ADC_TRIGGER_FREE
+#endif
+
+#ifndef ADC_RING_SIZE
+#define ADC_RING_SIZE 16
+#endif
+
+#ifndef ADC_MAX_CHANNELS
+#define ADC_MAX_CHANNELS 8
+#endif
+
+#ifndef ADC_DISCARD
+#define ADC_DISCARD 1
+#endif
+
+#ifndef ADC_DISCARD_REF
+#define ADC_DISCARD_REF 4
+#endif
+
+// reference, or-ed with the channel into adc_channel_t.admux
+#define ADC_REF_AREF 0
+#define ADC_REF_AVCC _BV(REFS0)
+#define ADC_REF_INTERNAL (_BV(REFS1) | _BV(REFS0))  // 1.1 V
+
+#define ADC_MUX_TEMP 8      // needs ADC_REF_INTERNAL
+#define ADC_MUX_BANDGAP 14  // 1.1 V, against AVCC gives the supply
+#define ADC_MUX_GND 15
+
+// flags
+#define ADC_STREAM 0x01     // results also go into the ring
+#define ADC_BITS(b) ((((b) - 10) & 0x07) << 4) // oversample to b bits
+#define ADC_BITS_MASK 0x70
+
+typedef struct {
+    uint8_t admux;      // ADC_REF_* | channel
+    uint8_t divider;    // converted every divider-th turn
+    uint8_t flags;
+} adc_channel_t;
+
+void setup_adc(const adc_channel_t *channels, uint8_t n);
+
+// latest result of channels[i], 0 until the first one, 10 bits or as
+// many as ADC_BITS asks for
+uint16_t adc_value(uint8_t i);
+
+uint8_t adc_available(void);
+int adc_read(void);
+
+uint16_t adc_overflows(void);
+
+#endif
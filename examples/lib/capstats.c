@@ -0,0 +1,71 @@
+#include <avr/io.h>
+
+#include "critical.h"
+#include "capstats.h"
+
+static void clear(volatile capstats_t *s)
+{
+    s->n = 0;
+    s->min = 0;
+    s->max = 0;
+    s->sum = 0;
+    s->sumsq = 0;
+    for (uint8_t i = 0; i < CAPSTATS_BINS; i++)
+        s->hist[i] = 0;
+}
+
+void capstats_init(volatile capstats_t *s)
+{
+    critical_t c = critical_begin();
+
+    clear(s);
+    s->dropped = 0;
+    critical_end(c);
+}
+
+void capstats_snapshot(volatile capstats_t *s, capstats_t *copy, uint8_t reset)
+{
+    critical_t c = critical_begin();
+
+    copy->n = s->n;
+    copy->min = s->min;
+    copy->max = s->max;
+    copy->ref = s->ref;
+    copy->prev = s->prev;
+    copy->sum = s->sum;
+    copy->sumsq = s->sumsq;
+    copy->dropped = s->dropped;
+    for (uint8_t i = 0; i < CAPSTATS_BINS; i++)
+        copy->hist[i] = s->hist[i];
+    if (reset) {
+        clear(s);
+        s->dropped = 0;
+    }
+    critical_end(c);
+}
+
+uint16_t capstats_mean(const capstats_t *s)
+{
+    int32_t half = s->n / 2;
+
+    if (s->n == 0)
+        return 0;
+
+    // rounded to the nearest tick
+    return s->ref + (s->sum < 0 ? s->sum - half : s->sum + half) / (int16_t)s->n;
+}
+
+// (n sum d^2 - (sum d)^2) / n^2, with d the deviation from ref; 64 bit
+// but only on request
+uint32_t capstats_variance(const capstats_t *s)
+{
+    int64_t n = s->n;
+    int64_t v;
+
+    if (n == 0)
+        return 0;
+
+    v = (n * s->sumsq - (int64_t)s->sum * s->sum) / (n * n);
+
+    return v < 0 ? 0 : v;
+}
@@ -0,0 +1,112 @@
+//
+// capstats.h
+//
+// Statistics of captured values, kept by the capture interrupt: count,
+// min, max, mean and variance over a window of up to CAPSTATS_WINDOW
+// samples, a histogram of the change from one sample to the next, n - 1
+// entries as the first sample of a window has none, and a count of
+// dropped samples. capstats_add() is incremental, fixed point and costs
+// about 100 cycles, so it runs at the full capture rate.
+//
+// Mean and variance are summed as deviations from the first sample of
+// the window, which keeps the sum of squares within 32 bits: deviations
+// are clamped to +-CAPSTATS_DEV_MAX ticks for the variance only, more
+// than an RC signal moves within a window.
+//
+// Once a window is full the statistics hold still until they are read
+// with capstats_snapshot(..., 1), which starts the next window; dropped
+// samples are counted throughout. See capture.h, -DCAPTURE_STATS.
+//
+
+#ifndef CAPSTATS_H
+#define CAPSTATS_H
+
+#include <stdint.h>
+
+#ifndef CAPSTATS_WINDOW
+#define CAPSTATS_WINDOW 256
+#endif
+
+// histogram bins, the middle bin holds a change of 0
+#ifndef CAPSTATS_BINS
+#define CAPSTATS_BINS 8
+#endif
+
+// ticks of change per bin, a power of two divides cheaply
+#ifndef CAPSTATS_BIN_TICKS
+#define CAPSTATS_BIN_TICKS 2
+#endif
+
+#define CAPSTATS_DEV_MAX 4095
+
+#if CAPSTATS_WINDOW > 256
+#error CAPSTATS_WINDOW must be 256 at most
+#endif
+
+typedef struct {
+    uint16_t n;         // samples in the window
+    uint16_t min;       // ticks
+    uint16_t max;
+    uint16_t ref;       // first sample of the window
+    uint16_t prev;      // previous sample
+    int32_t sum;        // of sample - ref
+    uint32_t sumsq;     // of (sample - ref)^2
+    uint16_t dropped;   // stops at 0xffff
+    uint16_t hist[CAPSTATS_BINS];
+} capstats_t;
+
+static inline void capstats_add(volatile capstats_t *s, uint16_t x)
+{
+    uint16_t n = s->n;
+    int16_t d, change;
+
+    if (n == CAPSTATS_WINDOW)
+        return;
+
+    // the first sample seeds the window, it has no change to count and
+    // adds nothing to the sums
+    if (n == 0) {
+        s->ref = s->min = s->max = s->prev = x;
+        s->n = 1;
+        return;
+    }
+
+    if (x < s->min)
+        s->min = x;
+    else if (x > s->max)
+        s->max = x;
+    s->n = n + 1;
+
+    d = x - s->ref;
+    s->sum += d;
+    if (d > CAPSTATS_DEV_MAX)
+        d = CAPSTATS_DEV_MAX;
+    else if (d < -CAPSTATS_DEV_MAX)
+        d = -CAPSTATS_DEV_MAX;
+    s->sumsq += (int32_t)d * d;
+
+    // shifted to be positive first, so the division rounds down
+    change = x - s->prev + CAPSTATS_BINS / 2 * CAPSTATS_BIN_TICKS;
+    s->prev = x;
+    if (change < 0)
+        change = 0;
+    change = (uint16_t)change / CAPSTATS_BIN_TICKS;
+    if (change >= CAPSTATS_BINS)
+        change = CAPSTATS_BINS - 1;
+    s->hist[change]++;
+}
+
+static inline void capstats_drop(volatile capstats_t *s)
+{
+    if (s->dropped != 0xffff)
+        s->dropped++;
+}
+
+void capstats_init(volatile capstats_t *s);
+void capstats_snapshot(volatile capstats_t *s, capstats_t *copy, uint8_t reset);
+
+// of the snapshot, in ticks and ticks^2; 0 without samples
+uint16_t capstats_mean(const capstats_t *s);
+uint32_t capstats_variance(const capstats_t *s);
+
+#endif
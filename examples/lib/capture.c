@@ -0,0 +1,294 @@
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "seqlock.h"
+#include "capture.h"
+
+#ifdef CAPTURE_STATS
+#include "capstats.h"
+#endif
+
+#if CAPTURE_MODE != CAPTURE_PWM && CAPTURE_MODE != CAPTURE_CPPM
+#error CAPTURE_MODE not set correctly
+#endif
+
+#if CAPTURE_CHANNELS > 16 || CAPTURE_MIN_CHANNELS > CAPTURE_CHANNELS
+#error CAPTURE_CHANNELS must be 16 at most and at least CAPTURE_MIN_CHANNELS
+#endif
+
+// only written by TIMER1_CAPT_vect
+static uint16_t rise;
+
+// written once per pulse or frame, then seq is bumped
+static volatile uint16_t period_result;
+static volatile seqlock_t seq;
+
+#ifdef CAPTURE_STATS
+#if CAPTURE_MODE == CAPTURE_PWM
+#define STATS_CHANNELS 1
+#else
+#define STATS_CHANNELS CAPTURE_CHANNELS
+#endif
+static volatile capstats_t stats[STATS_CHANNELS];
+#define STATS_ADD(i, x) capstats_add(&stats[i], x)
+#define STATS_DROP(i) capstats_drop(&stats[i])
+#else
+#define STATS_ADD(i, x) do { } while (0)
+#define STATS_DROP(i) do { } while (0)
+#endif
+
+#if CAPTURE_MODE == CAPTURE_PWM
+
+static uint16_t period;
+static uint8_t started;
+
+static volatile uint16_t width_result;
+
+ISR(TIMER1_CAPT_vect)
+{
+    uint16_t t = ICR1;
+
+    if (bit_is_set(TCCR1B, ICES1)) {
+        if (started) {
+            uint16_t p = t - rise;
+
+            // half a period longer than the one before, a pulse is missing
+            if (p > period + period / 2 && period != 0)
+                STATS_DROP(0);
+            period = p;
+        }
+        started = 1;
+        rise = t;
+        // was rising edge -> set to detect falling edge
+        TCCR1B &= ~_BV(ICES1);
+#ifdef CAPTURE_LED_PIN
+        PORTB |= _BV(CAPTURE_LED_PIN);
+#endif
+    } else {
+        uint16_t w = t - rise;
+
+        width_result = w;
+        period_result = period;
+        STATS_ADD(0, w);
+        seqlock_write(&seq);
+        // was falling -> now set to detect rising edge
+        TCCR1B |= _BV(ICES1);
+#ifdef CAPTURE_LED_PIN
+        PORTB &= ~_BV(CAPTURE_LED_PIN);
+#endif
+    }
+
+    // changing the edge can set the flag, see the datasheet
+    TIFR1 = _BV(ICF1);
+}
+
+#else // CAPTURE_CPPM
+
+// slot values that are not a channel index
+#define SLOT_START 0xfd // no edge yet to measure from
+#define SLOT_WAIT 0xfe  // before the first sync gap
+#define SLOT_BAD 0xff   // frame is corrupt, wait for the next gap
+
+static uint16_t frame_start;
+static uint8_t slot = SLOT_START;
+
+// the interrupt fills frames[front ^ 1]
+static volatile uint16_t frames[2][CAPTURE_CHANNELS];
+static volatile uint8_t front;
+static volatile uint8_t front_n;
+
+static volatile uint16_t corrupt_count;
+
+#ifdef CAPTURE_STATS
+// Statistics only take channels of valid frames. Those of the front
+// frame go in one per slot edge of the frames after it, so a channel
+// costs one capstats_add() as before, just a frame late.
+static uint8_t stats_next;
+static uint8_t stats_n;
+
+static inline void stats_add_next(void)
+{
+    STATS_ADD(stats_next, frames[front][stats_next]);
+    stats_next++;
+}
+#endif
+
+ISR(TIMER1_CAPT_vect)
+{
+    uint16_t t = ICR1;
+    uint16_t d = t - rise;
+    uint8_t i = slot;
+
+    rise = t;
+
+    // the time since reset is no gap
+    if (i == SLOT_START) {
+        slot = SLOT_WAIT;
+        return;
+    }
+
+    if (d > US_TO_TICKS(CAPTURE_SYNC_US)) {
+        if (i >= CAPTURE_MIN_CHANNELS && i <= CAPTURE_CHANNELS) {
+#ifdef CAPTURE_STATS
+            // only left when this frame has fewer channels
+            while (stats_next < stats_n)
+                stats_add_next();
+            stats_next = 0;
+            stats_n = i;
+#endif
+            front ^= 1;
+            front_n = i;
+            period_result = t - frame_start;
+            seqlock_write(&seq);
+#ifdef CAPTURE_LED_PIN
+            PINB = _BV(CAPTURE_LED_PIN);
+#endif
+        } else if (i != SLOT_WAIT) {
+            corrupt_count++;
+#ifdef CAPTURE_STATS
+            // channels the frame did not get to
+            for (; i < front_n; i++)
+                STATS_DROP(i);
+#endif
+        }
+        frame_start = t;
+        slot = 0;
+        return;
+    }
+
+    if (i >= CAPTURE_CHANNELS) {
+        // one slot too many, or already waiting for the gap
+        if (i == CAPTURE_CHANNELS)
+            slot = SLOT_BAD;
+        return;
+    }
+
+    if (d < US_TO_TICKS(CAPTURE_SLOT_MIN_US) || d > US_TO_TICKS(CAPTURE_SLOT_MAX_US)) {
+        STATS_DROP(i);
+        slot = SLOT_BAD;
+        return;
+    }
+
+    frames[front ^ 1][i] = d;
+#ifdef CAPTURE_STATS
+    if (stats_next < stats_n)
+        stats_add_next();
+#endif
+    slot = i + 1;
+}
+
+#endif
+
+void setup_capture(void)
+{
+    setup_ticks();
+
+    // ICP1 input
+    DDRB &= ~_BV(PB0);
+#ifdef CAPTURE_LED_PIN
+    DDRB |= _BV(CAPTURE_LED_PIN);
+#endif
+
+#ifdef CAPTURE_STATS
+    for (uint8_t i = 0; i < STATS_CHANNELS; i++)
+        capstats_init(&stats[i]);
+#endif
+
+    TCCR1B |= _BV(ICES1); // trigger input capture on rising edge
+    TIFR1 = _BV(ICF1);
+    TIMSK1 |= _BV(ICIE1); // input capture interrupt enable
+}
+
+#if CAPTURE_MODE == CAPTURE_PWM
+
+void capture_get(capture_t *c)
+{
+    seqlock_t s;
+
+    do {
+        s = seqlock_begin(&seq);
+        c->width = width_result;
+        c->period = period_result;
+    } while (seqlock_retry(&seq, s));
+    c->count = s;
+}
+
+#else // CAPTURE_CPPM
+
+void capture_get(capture_t *c)
+{
+    seqlock_t s;
+
+    do {
+        s = seqlock_begin(&seq);
+        c->width = front_n ? frames[front][0] : 0;
+        c->period = period_result;
+    } while (seqlock_retry(&seq, s));
+    c->count = s;
+}
+
+void capture_frame(capture_frame_t *f)
+{
+    seqlock_t s;
+    uint8_t n;
+
+    do {
+        s = seqlock_begin(&seq);
+        n = front_n;
+        for (uint8_t i = 0; i < n; i++)
+            f->ch[i] = frames[front][i];
+    } while (seqlock_retry(&seq, s));
+    f->n = n;
+    f->count = s;
+}
+
+uint16_t capture_corrupt(void)
+{
+    uint16_t n;
+
+    do {
+        n = corrupt_count;
+    } while (n != corrupt_count);
+
+    return n;
+}
+
+#endif
+
+void capture_failsafe_init(capture_failsafe_t *f, uint16_t now)
+{
+    f->count = seqlock_begin(&seq);
+    f->last = now;
+    f->failed = 1;
+}
+
+uint8_t capture_failsafe(capture_failsafe_t *f, const capture_t *c, uint16_t now)
+{
+    if (c->count != f->count) {
+        f->count = c->count;
+        if (c->width >= f->min && c->width <= f->max) {
+            f->last = now;
+            f->failed = 0;
+        }
+    }
+
+    if ((uint16_t)(now - f->last) > (uint16_t)f->frames * f->frame_ms)
+        f->failed = 1;
+
+    return f->failed;
+}
+
+uint16_t capture_duty(const capture_t *c)
+{
+    if (c->period == 0)
+        return 0;
+
+    return (uint32_t)c->width * 1000 / c->period;
+}
+
+#ifdef CAPTURE_STATS
+void capture_stats(uint8_t ch, capstats_t *copy, uint8_t reset)
+{
+    capstats_snapshot(&stats[ch], copy, reset);
+}
+#endif
@@ -0,0 +1,164 @@
+//
+// capture.h
+//
+// Pulse capture on ICP1 (PB0) against the free-running timer1 of
+// setup_ticks(). TIMER1_CAPT_vect never touches TCNT1: the hardware
+// latches the count of every edge into ICR1, and the interrupt only
+// subtracts timestamps, so interrupt latency does not enter the result
+// and no fudge constant is needed. Differences are taken with unsigned
+// 16 bit subtraction, which is right across the wrap of the counter as
+// long as the period is below 65536 ticks (32.8 ms at 16 MHz).
+//
+//   width    rising to falling edge, the high time
+//   period   rising to rising edge
+//
+// in timer1 ticks, TICKS_TO_US() converts. Both are published together
+// at the falling edge; capture_get() copies them without disabling
+// interrupts, see seqlock.h, so it never returns a torn value or a width
+// and period of different pulses. capture_duty() gives the high share
+// in permille.
+//
+// Failsafe: capture_failsafe() checks the latest capture once per call
+// and reports a failure when no pulse with a width in min..max arrived
+// for more than frames * frame_ms milliseconds, e.g.
+//
+//   static capture_failsafe_t failsafe = {
+//       .min = US_TO_TICKS(900), .max = US_TO_TICKS(2100),
+//       .frames = 3, .frame_ms = 20,
+//   };
+//
+//   capture_failsafe_init(&failsafe, millis());
+//   ...
+//   capture_get(&c);
+//   if (capture_failsafe(&failsafe, &c, millis()))
+//       outputs off
+//
+// The reaction time is at most frames * frame_ms plus the interval of
+// the calls. It starts out failed until the first valid pulse.
+//
+// Timer1 stays shareable: setup_capture() only adds ICES1 and the input
+// capture interrupt enable, the counter keeps running in normal mode.
+// Compare users can still schedule on OCR1A/OCR1B relative to TCNT1 or
+// to an edge timestamp. Modes that reset the counter, such as fast pwm
+// with ICR1 as TOP in bubbledisplay, cannot share it.
+//
+// The interrupt reads ICR1 through the timer1 TEMP register, so with
+// capture on ticks16() has to be read with interrupts disabled.
+//
+// Optionally the state of the input is mirrored on a port B pin,
+// -DCAPTURE_LED_PIN=PB2.
+//
+// CAPTURE_MODE selects what the interrupt decodes:
+//
+//   CAPTURE_PWM    one channel, a pulse per frame, as above
+//   CAPTURE_CPPM   a sum signal of up to CAPTURE_CHANNELS channels
+//
+// A CPPM frame is a pulse per channel; the channel value is the time
+// between the same edges of two pulses, 1000..2000 us, and a gap longer
+// than CAPTURE_SYNC_US ends the frame. Only rising edges are captured,
+// so the polarity of the signal does not matter. The interrupt fills
+// the back one of two channel arrays and at the sync gap makes it the
+// front one when the frame is valid: at least CAPTURE_MIN_CHANNELS and
+// at most CAPTURE_CHANNELS slots, each within CAPTURE_SLOT_MIN_US ..
+// CAPTURE_SLOT_MAX_US. Otherwise the frame is dropped and counted by
+// capture_corrupt(). capture_frame() copies the front array lock-free;
+// capture_get() gives channel 0 as the width and the frame length as the
+// period, so capture_failsafe() works for both modes. An interrupt
+// costs about 60 cycles, every channel arrives at the full frame rate.
+// On CAPTURE_LED_PIN the led toggles with every valid frame.
+//
+// With -DCAPTURE_STATS the interrupt also keeps capstats_t statistics
+// of every width or channel, see capstats.h; capture_stats() copies
+// them. A pulse counts as dropped when a period is half as long again
+// as the one before, a CPPM slot when it is out of range or missing
+// from a frame shorter than the previous one. CPPM statistics only take
+// the channels of valid frames; they go in during the frame after, so
+// they lag by one frame. This adds ~100 cycles per value and 36 bytes of
+// RAM per channel, plus the object capstats.o.
+//
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdint.h>
+
+#include "ticks.h"
+
+#ifdef CAPTURE_STATS
+#include "capstats.h"
+#endif
+
+#define CAPTURE_PWM 0
+#define CAPTURE_CPPM 1
+
+#ifndef CAPTURE_MODE
+#define CAPTURE_MODE CAPTURE_PWM
+#endif
+
+#ifndef CAPTURE_CHANNELS
+#define CAPTURE_CHANNELS 8
+#endif
+
+#ifndef CAPTURE_MIN_CHANNELS
+#define CAPTURE_MIN_CHANNELS 4
+#endif
+
+#ifndef CAPTURE_SYNC_US
+#define CAPTURE_SYNC_US 2700
+#endif
+
+#ifndef CAPTURE_SLOT_MIN_US
+#define CAPTURE_SLOT_MIN_US 700
+#endif
+
+#ifndef CAPTURE_SLOT_MAX_US
+#define CAPTURE_SLOT_MAX_US 2300
+#endif
+
+typedef struct {
+    uint16_t width;     // ticks high, 0 until the first pulse
+    uint16_t period;    // ticks between rising edges, 0 until the second
+    uint8_t count;      // pulses so far, wraps
+} capture_t;
+
+typedef struct {
+    uint16_t ch[CAPTURE_CHANNELS];  // ticks, CAPTURE_CPPM only
+    uint8_t n;          // channels in the frame, 0 until the first
+    uint8_t count;      // frames so far, wraps
+} capture_frame_t;
+
+typedef struct {
+    uint16_t min;       // valid width in ticks
+    uint16_t max;
+    uint8_t frames;     // frames that may go missing
+    uint8_t frame_ms;   // nominal frame period
+
+    uint8_t count;      // capture_t.count at the last check
+    uint16_t last;      // millis of the last valid pulse
+    uint8_t failed;
+} capture_failsafe_t;
+
+// Calls setup_ticks(), then enables the capture interrupt.
+void setup_capture(void);
+
+void capture_get(capture_t *c);
+
+// width / period in permille, 0 without a period
+uint16_t capture_duty(const capture_t *c);
+
+#if CAPTURE_MODE == CAPTURE_CPPM
+void capture_frame(capture_frame_t *f);
+uint16_t capture_corrupt(void);
+#endif
+
+#ifdef CAPTURE_STATS
+// ch is the CPPM channel, 0 in CAPTURE_PWM mode
+void capture_stats(uint8_t ch, capstats_t *copy, uint8_t reset);
+#endif
+
+void capture_failsafe_init(capture_failsafe_t *f, uint16_t now);
+
+// 1 while failed; now in milliseconds, e.g. millis()
+uint8_t capture_failsafe(capture_failsafe_t *f, const capture_t *c, uint16_t now);
+
+#endif
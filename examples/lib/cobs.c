@@ -0,0 +1,51 @@
+#include "cobs.h"
+
+uint16_t cobs_encode(const uint8_t *src, uint16_t len, uint8_t *dst)
+{
+    uint16_t code_index = 0;
+    uint16_t n = 1;
+    uint8_t code = 1;
+
+    while (len-- > 0) {
+        uint8_t c = *src++;
+
+        if (c != 0) {
+            dst[n++] = c;
+            code++;
+        }
+
+        if (c == 0 || code == 0xff) {
+            dst[code_index] = code;
+            code_index = n++;
+            code = 1;
+        }
+    }
+
+    dst[code_index] = code;
+
+    return n;
+}
+
+uint16_t cobs_decode(const uint8_t *src, uint16_t len, uint8_t *dst)
+{
+    const uint8_t *end = src + len;
+    uint16_t n = 0;
+
+    while (src < end) {
+        uint8_t code = *src++;
+
+        if (code == 0 || src + code - 1 > end)
+            return 0;
+
+        for (uint8_t i = 1; i < code; i++) {
+            if (*src == 0)
+                return 0;
+            dst[n++] = *src++;
+        }
+
+        if (code != 0xff && src < end)
+            dst[n++] = 0;
+    }
+
+    return n;
+}
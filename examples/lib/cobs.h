@@ -0,0 +1,23 @@
+//
+// cobs.h
+//
+// Consistent Overhead Byte Stuffing. An encoded frame never contains a
+// zero byte, so a single 0x00 can be used as the frame delimiter. The
+// overhead is one byte per 254 bytes of input. Plain C, shared by the
+// firmware and the host tools.
+//
+
+#ifndef COBS_H
+#define COBS_H
+
+#include <stdint.h>
+
+// worst case size of the encoded data, not counting the delimiter
+#define COBS_ENCODED_SIZE(n) ((n) + (n) / 254 + 1)
+
+uint16_t cobs_encode(const uint8_t *src, uint16_t len, uint8_t *dst);
+
+// returns the decoded length or 0 if the frame is malformed
+uint16_t cobs_decode(const uint8_t *src, uint16_t len, uint8_t *dst);
+
+#endif
@@ -0,0 +1,231 @@
+#include <avr/pgmspace.h>
+#include <stdint.h>
+
+#include "command.h"
+#include "usart.h"
+
+enum {
+    STATE_VERB,
+    STATE_NAME,
+    STATE_VALUE,
+    STATE_ERROR,
+};
+
+enum {
+    VERB_GET = 0,
+    VERB_SET = 1,
+};
+
+static const char verb_get[] PROGMEM = "get";
+static const char verb_set[] PROGMEM = "set";
+
+static const char * const verbs[] PROGMEM = {
+    verb_get,
+    verb_set,
+};
+
+static const command_param_t *params;
+static uint8_t n_params;
+
+static uint8_t state;
+static uint8_t verb;
+static uint8_t pos;
+static uint16_t candidates;
+static uint8_t negative;
+static uint8_t have_digits;
+static int16_t value;
+
+static uint16_t all(uint8_t n)
+{
+    return n >= 16 ? 0xffff : (1U << n) - 1;
+}
+
+static const char *param_name(uint8_t i)
+{
+    return (const char *)pgm_read_word(&params[i].name);
+}
+
+static const char *verb_name(uint8_t i)
+{
+    return (const char *)pgm_read_word(&verbs[i]);
+}
+
+// drop every candidate whose name does not have c at position pos
+static uint16_t match(uint16_t mask, const char *(*name)(uint8_t), uint8_t c)
+{
+    uint16_t bit = 1;
+
+    for (uint8_t i = 0; mask >= bit && bit != 0; i++, bit <<= 1) {
+        if ((mask & bit) && pgm_read_byte(name(i) + pos) != c)
+            mask &= ~bit;
+    }
+
+    return mask;
+}
+
+// the one candidate whose name ends at pos, 0xff if none
+static uint8_t complete(uint16_t mask, const char *(*name)(uint8_t))
+{
+    uint16_t bit = 1;
+
+    for (uint8_t i = 0; mask >= bit && bit != 0; i++, bit <<= 1) {
+        if ((mask & bit) && pgm_read_byte(name(i) + pos) == '\0')
+            return i;
+    }
+
+    return 0xff;
+}
+
+static void reset(void)
+{
+    state = STATE_VERB;
+    pos = 0;
+    candidates = all(sizeof(verbs) / sizeof(verbs[0]));
+    negative = 0;
+    have_digits = 0;
+    value = 0;
+}
+
+// Digits by repeated subtraction, like convert() in display.c: at most 9
+// steps per digit and no call into the 16 bit division.
+static void write_int(int16_t v)
+{
+    static const uint16_t powers[] PROGMEM = { 10000, 1000, 100, 10 };
+    uint16_t u = v < 0 ? -(uint16_t)v : v;
+    uint8_t leading = 1;
+
+    if (v < 0)
+        usart_write('-');
+    for (uint8_t k = 0; k < 4; k++) {
+        uint16_t p = pgm_read_word(&powers[k]);
+        char c = '0';
+
+        while (u >= p) {
+            u -= p;
+            c++;
+        }
+        if (c != '0' || !leading) {
+            usart_write(c);
+            leading = 0;
+        }
+    }
+    usart_write('0' + u);
+}
+
+static void reply(uint8_t i)
+{
+    const char *p = param_name(i);
+    char c;
+
+    // name, '=', up to 6 characters of value, "\r\n"
+    if (usart_tx_free() < strlen_P(p) + 9)
+        return;
+
+    while ((c = pgm_read_byte(p++)) != '\0')
+        usart_write(c);
+    usart_write('=');
+    write_int(*(int16_t *)pgm_read_word(&params[i].value));
+    usart_write_string("\r\n");
+}
+
+static void execute(void)
+{
+    uint8_t i = complete(candidates, param_name);
+    void (*changed)(void);
+
+    if (state == STATE_NAME && verb == VERB_GET && i != 0xff) {
+        reply(i);
+    } else if (state == STATE_VALUE && verb == VERB_SET && i != 0xff && have_digits) {
+        int16_t min = pgm_read_word(&params[i].min);
+        int16_t max = pgm_read_word(&params[i].max);
+        int16_t v = negative ? -value : value;
+
+        // read only
+        if (min > max) {
+            usart_write_string("?\r\n");
+            return;
+        }
+
+        if (v < min)
+            v = min;
+        if (v > max)
+            v = max;
+
+        *(int16_t *)pgm_read_word(&params[i].value) = v;
+
+        changed = (void (*)(void))pgm_read_word(&params[i].changed);
+        if (changed)
+            changed();
+
+        reply(i);
+    } else {
+        usart_write_string("?\r\n");
+    }
+}
+
+void command_init(const command_param_t *table, uint8_t n)
+{
+    params = table;
+    n_params = n > COMMAND_MAX_PARAMS ? COMMAND_MAX_PARAMS : n;
+    reset();
+}
+
+void command_feed(uint8_t c)
+{
+    if (c == '\r' || c == '\n') {
+        // empty lines, e.g. the \n of \r\n, are ignored
+        if (state != STATE_VERB || pos != 0)
+            execute();
+        reset();
+        return;
+    }
+
+    switch (state) {
+    case STATE_VERB:
+        if (c == ' ') {
+            verb = complete(candidates, verb_name);
+            if (verb == 0xff) {
+                state = STATE_ERROR;
+            } else {
+                state = STATE_NAME;
+                pos = 0;
+                candidates = all(n_params);
+            }
+        } else {
+            candidates = match(candidates, verb_name, c);
+            pos++;
+        }
+        break;
+
+    case STATE_NAME:
+        if (c == ' ') {
+            state = STATE_VALUE;
+        } else {
+            candidates = match(candidates, param_name, c);
+            pos++;
+        }
+        break;
+
+    case STATE_VALUE:
+        if (c == '-' && !have_digits && !negative) {
+            negative = 1;
+        } else if (c >= '0' && c <= '9') {
+            // saturate instead of overflowing, clamped to max later
+            if (value < 3276 || (value == 3276 && c <= '7'))
+                value = value * 10 + (c - '0');
+            else
+                value = 32767;
+            have_digits = 1;
+        } else {
+            state = STATE_ERROR;
+        }
+        break;
+
+    default:
+        break;
+    }
+
+    // names longer than any in the table
+    if (candidates == 0)
+        state = STATE_ERROR;
+}
@@ -0,0 +1,46 @@
+//
+// command.h
+//
+// Line oriented get/set of named parameters over the serial port:
+//
+//   get <name>          -> <name>=<value>
+//   set <name> <value>  -> <name>=<value>   (value clamped to min..max)
+//
+// Anything else is answered with "?", so is a set of a read-only
+// parameter: one with min > max, COMMAND_READ_ONLY in their place. The
+// parameter table lives in PROGMEM and holds at most 16 entries.
+//
+// command_feed() does a bounded amount of work for every byte: names are
+// matched incrementally against all table entries that still match, so
+// no line buffer is kept and nothing is ever scanned twice. Estimated
+// from the generated code at -Os, a byte costs about 40 cycles plus
+// about 20 cycles per table entry still matching (~360 cycles for a full
+// 16 entry table). The end of line byte also formats the reply, about 30
+// cycles for each character put into the tx buffer plus at most 9
+// subtractions per digit of the value: ~700 cycles for an 8 character
+// name and a 5 digit value. The reply is written to the usart without
+// waiting; it is dropped if the tx buffer is full.
+//
+
+#ifndef COMMAND_H
+#define COMMAND_H
+
+#include <stdint.h>
+
+#define COMMAND_MAX_PARAMS 16
+
+// min and max of a parameter that can only be read, e.g. a measurement
+#define COMMAND_READ_ONLY 1, 0
+
+typedef struct {
+    const char *name;       // PROGMEM string
+    int16_t *value;
+    int16_t min;
+    int16_t max;            // below min for read only
+    void (*changed)(void);  // called after a set, may be NULL
+} command_param_t;
+
+void command_init(const command_param_t *params, uint8_t n);
+void command_feed(uint8_t c);
+
+#endif
@@ -0,0 +1,41 @@
+//
+// crc16.h
+//
+// CRC-CCITT as computed by _crc_ccitt_update() from avr-libc's
+// <util/crc16.h> (polynomial 0x8408, reflected). The firmware uses the
+// avr-libc inline assembly version, the host tools the C version below;
+// both give identical results. Start with CRC16_INIT.
+//
+
+#ifndef CRC16_H
+#define CRC16_H
+
+#include <stdint.h>
+
+#define CRC16_INIT 0xffff
+
+#ifdef __AVR__
+#include <util/crc16.h>
+#define crc16_update(crc, data) _crc_ccitt_update((crc), (data))
+#else
+static inline uint16_t crc16_update(uint16_t crc, uint8_t data)
+{
+    data ^= crc & 0xff;
+    data ^= data << 4;
+
+    return ((((uint16_t)data << 8) | (crc >> 8)) ^ (uint8_t)(data >> 4)
+            ^ ((uint16_t)data << 3));
+}
+#endif
+
+static inline uint16_t crc16(const uint8_t *p, uint16_t len)
+{
+    uint16_t crc = CRC16_INIT;
+
+    while (len-- > 0)
+        crc = crc16_update(crc, *p++);
+
+    return crc;
+}
+
+#endif
@@ -0,0 +1,42 @@
+//
+// critical.h
+//
+// Nesting-safe critical sections. critical_begin() disables interrupts
+// and returns the previous SREG, critical_end() restores it, so the end
+// of an inner section leaves interrupts off when the caller had them
+// off. Unlike a cli()/sei() pair this is safe to use from interrupt
+// routines and from code called with interrupts disabled:
+//
+//   critical_t c = critical_begin();
+//   ...
+//   critical_end(c);
+//
+// The memory clobbers in cli() and on the SREG write keep the compiler
+// from moving memory accesses out of the section.
+//
+
+#ifndef CRITICAL_H
+#define CRITICAL_H
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <stdint.h>
+
+typedef uint8_t critical_t;
+
+static inline critical_t critical_begin(void)
+{
+    critical_t sreg = SREG;
+
+    cli();
+
+    return sreg;
+}
+
+static inline void critical_end(critical_t sreg)
+{
+    __asm__ volatile ("" ::: "memory");
+    SREG = sreg;
+}
+
+#endif
@@ -0,0 +1,481 @@
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+
+#include "display.h"
+
+#ifdef DISPLAY_LEVELS
+#define TIMER2_PERIOD_US DISPLAY_SLOT_US
+#include "timer2conf.h"
+
+#ifdef DISPLAY_MEASURE
+volatile uint8_t display_store_ticks;
+#endif
+
+// Shortest lit time in timer2 ticks. The compare value is written by
+// display_update() after the slot has started; it has to lie beyond the
+// time the store takes or the match is missed. That is the path from the
+// compare match to the OCR2B store, interrupt response, the prologue of
+// the refresh interrupt and the first lines of display_update(),
+// examples/displaybench measures it; plus the longest other interrupt
+// routine that can hold off the refresh, the adc or timer0 overflow
+// routine in the examples. A later store is caught by display_update()
+// itself, the digit then stays dark for the slot.
+#ifndef DISPLAY_STORE_CYCLES
+#define DISPLAY_STORE_CYCLES 60
+#endif
+#ifndef DISPLAY_ISR_DELAY_CYCLES
+#define DISPLAY_ISR_DELAY_CYCLES 100
+#endif
+#define MIN_TICKS ((DISPLAY_STORE_CYCLES + DISPLAY_ISR_DELAY_CYCLES + \
+                    TIMER2_PRESCALE - 1) / TIMER2_PRESCALE)
+
+#if MIN_TICKS >= TIMER2_TICKS
+#error DISPLAY_SLOT_US too short for dimming
+#elif TIMER2_TOP >= 255
+// a compare value beyond TOP keeps a digit lit for the whole slot
+#error DISPLAY_SLOT_US needs all 256 timer2 ticks, no room for dimming
+#endif
+
+// (level / (DISPLAY_LEVELS - 1))^2.2 * 65535
+static const uint16_t gamma[DISPLAY_LEVELS] PROGMEM = {
+#if DISPLAY_LEVELS == 16
+    0, 169, 779, 1900, 3578, 5845, 8730, 12254, 16439, 21301, 26858, 33124,
+    40112, 47835, 56306, 65535,
+#elif DISPLAY_LEVELS == 32
+    0, 34, 158, 385, 724, 1184, 1768, 2481, 3329, 4313, 5438, 6707, 8122,
+    9686, 11401, 13270, 15295, 17477, 19819, 22322, 24989, 27820, 30818,
+    33984, 37320, 40827, 44506, 48359, 52387, 56592, 60974, 65535,
+#elif DISPLAY_LEVELS == 64
+    0, 7, 33, 81, 152, 249, 371, 521, 699, 906, 1143, 1409, 1707, 2035,
+    2396, 2788, 3214, 3672, 4164, 4690, 5250, 5845, 6475, 7140, 7841, 8578,
+    9351, 10161, 11007, 11890, 12811, 13770, 14766, 15800, 16872, 17983,
+    19133, 20322, 21550, 22817, 24124, 25471, 26858, 28285, 29752, 31260,
+    32809, 34398, 36029, 37701, 39415, 41170, 42967, 44805, 46686, 48610,
+    50575, 52583, 54634, 56728, 58865, 61045, 63268, 65535,
+#else
+#error DISPLAY_LEVELS must be 16, 32 or 64
+#endif
+};
+#endif
+
+#if DISPLAY_SCAN == DISPLAY_SCAN_SEGMENT
+#define SLOTS_PER_DIGIT 7
+#elif DISPLAY_SCAN == DISPLAY_SCAN_HALF_DIGIT
+#define SLOTS_PER_DIGIT 2
+#elif DISPLAY_SCAN == DISPLAY_SCAN_DIGIT
+#define SLOTS_PER_DIGIT 1
+#else
+#error DISPLAY_SCAN not set correctly
+#endif
+
+#define SLOTS_PER_FRAME (4 * SLOTS_PER_DIGIT)
+
+// frames per scroll step
+#define SCROLL_FRAMES \
+    ((DISPLAY_SCROLL_MS * 1000L + DISPLAY_SLOT_US * SLOTS_PER_FRAME / 2) / \
+     (DISPLAY_SLOT_US * SLOTS_PER_FRAME))
+
+#if SCROLL_FRAMES < 1 || SCROLL_FRAMES > 255
+#error DISPLAY_SCROLL_MS out of range for this frame rate
+#endif
+
+#define MINUS 0b01000000
+
+// Segments G..A in bits 6..0, ASCII ' ' to DEL. Letters that have no
+// readable 7 segment form (K M V W X) are blank, B D N R T are drawn as
+// b d n r t. '.' and ',' are the decimal point, '^' is a degree sign.
+static const uint8_t font[] PROGMEM = {
+    // space ! " # $ % & ' ( ) * + , - . /
+    0x00, 0x00, 0x22, 0x00, 0x00, 0x00, 0x00, 0x02,
+    0x39, 0x0f, 0x00, 0x00, DISPLAY_DP, MINUS, DISPLAY_DP, 0x52,
+    // 0 1 2 3 4 5 6 7 8 9 : ; < = > ?
+    0x3f, 0x06, 0x5b, 0x4f, 0x66, 0x6d, 0x7d, 0x07,
+    0x7f, 0x6f, 0x00, 0x00, 0x00, 0x48, 0x00, 0x53,
+    // @ A B C D E F G H I J K L M N O
+    0x00, 0x77, 0x7c, 0x39, 0x5e, 0x79, 0x71, 0x3d,
+    0x76, 0x30, 0x1e, 0x00, 0x38, 0x00, 0x37, 0x3f,
+    // P Q R S T U V W X Y Z [ \ ] ^ _
+    0x73, 0x67, 0x50, 0x6d, 0x78, 0x3e, 0x00, 0x00,
+    0x00, 0x6e, 0x5b, 0x39, 0x64, 0x0f, 0x63, 0x08,
+    // ` a b c d e f g h i j k l m n o
+    0x20, 0x5f, 0x7c, 0x58, 0x5e, 0x7b, 0x71, 0x6f,
+    0x74, 0x10, 0x0e, 0x00, 0x30, 0x00, 0x54, 0x5c,
+    // p q r s t u v w x y z { | } ~ DEL
+    0x73, 0x67, 0x50, 0x6d, 0x78, 0x1c, 0x00, 0x00,
+    0x00, 0x6e, 0x5b, 0x39, 0x30, 0x0f, 0x00, 0x00,
+};
+
+static const uint8_t cathode[4] PROGMEM = {
+    _BV(PIN_CATHODE_DIGIT_0),
+    _BV(PIN_CATHODE_DIGIT_1),
+    _BV(PIN_CATHODE_DIGIT_2),
+    _BV(PIN_CATHODE_DIGIT_3),
+};
+
+#if DISPLAY_SCAN == DISPLAY_SCAN_SEGMENT
+static const uint8_t slot_mask[SLOTS_PER_DIGIT] PROGMEM = {
+    _BV(PIN_ANODE_SEG_A), _BV(PIN_ANODE_SEG_B), _BV(PIN_ANODE_SEG_C),
+    _BV(PIN_ANODE_SEG_D), _BV(PIN_ANODE_SEG_E), _BV(PIN_ANODE_SEG_F),
+    _BV(PIN_ANODE_SEG_G),
+};
+#elif DISPLAY_SCAN == DISPLAY_SCAN_HALF_DIGIT
+static const uint8_t slot_mask[SLOTS_PER_DIGIT] PROGMEM = {
+    _BV(PIN_ANODE_SEG_A) | _BV(PIN_ANODE_SEG_B) | _BV(PIN_ANODE_SEG_C) | _BV(PIN_ANODE_SEG_D),
+    _BV(PIN_ANODE_SEG_E) | _BV(PIN_ANODE_SEG_F) | _BV(PIN_ANODE_SEG_G),
+};
+#endif
+
+static uint8_t glyph(char c)
+{
+    uint8_t i = c - ' ';
+
+    return i < sizeof(font) ? pgm_read_byte(&font[i]) : 0;
+}
+
+void setup_display(volatile display_t *d)
+{
+    // turn rx/tx on PD0 and PD1 off
+    UCSR0B = 0;
+
+    // display anodes PD0 .. PD6
+    DDRD = PIN_ANODES_MASK;
+
+    // display cathodes
+    DDRC = PIN_CATHODES_MASK;
+    PORTC |= PIN_CATHODES_MASK;
+
+#ifdef DISPLAY_DP_PIN
+    DDRB |= _BV(DISPLAY_DP_PIN);
+#endif
+
+#ifdef DISPLAY_LEVELS
+    // a zeroed blank_at would blank every digit as it lights
+    display_brightness(d, DISPLAY_LEVELS - 1);
+#endif
+}
+
+// Show the next window of a text longer than 4 characters, followed by
+// a gap of 4 blanks. Runs in display_update() at a frame boundary and
+// writes the front framebuffer, it is not being shown just then.
+static void scroll(volatile display_t *d)
+{
+    uint8_t len = d->text_len;
+    uint8_t end = len + 4;
+    uint8_t pos = d->scroll_pos;
+    volatile uint8_t *fb = d->fb[d->front];
+
+    if (++pos == end)
+        pos = 0;
+    d->scroll_pos = pos;
+
+    // digit 3 is leftmost
+    for (int8_t k = 3; k >= 0; k--) {
+        fb[k] = pos < len ? d->text[pos] : 0;
+        if (++pos == end)
+            pos = 0;
+    }
+
+    d->scroll_count = SCROLL_FRAMES;
+}
+
+void display_update(volatile display_t *d)
+{
+    uint8_t digit = d->digit;
+    uint8_t slot = d->segment;
+    uint8_t anodes;
+
+    // all cathodes off while the anodes change, no ghosting
+    PORTC |= PIN_CATHODES_MASK;
+
+#ifdef DISPLAY_LEVELS
+    // first thing, the store races the compare match
+    OCR2B = d->blank_at[digit];
+#ifdef DISPLAY_MEASURE
+    display_store_ticks = TCNT2;
+#endif
+#endif
+
+    if (digit == 0 && slot == 0) {
+        // frame boundary, show the framebuffer published last
+        if (d->flip) {
+            d->front ^= 1;
+            d->flip = 0;
+        }
+        if (d->scroll && --d->scroll_count == 0)
+            scroll(d);
+    }
+
+    if (!d->on)
+        return;
+
+    const volatile uint8_t *fb = d->fb[d->front];
+
+#ifdef DISPLAY_DP_PIN
+    // the decimal point is lit with the first slot of its digit
+    if (slot == 0 && (fb[digit] & DISPLAY_DP))
+        PORTB |= _BV(DISPLAY_DP_PIN);
+    else
+        PORTB &= ~_BV(DISPLAY_DP_PIN);
+#endif
+
+#if SLOTS_PER_DIGIT == 1
+    anodes = fb[digit] & PIN_ANODES_MASK;
+    d->digit = (digit + 1) & 3;
+#else
+    anodes = fb[digit] & pgm_read_byte(&slot_mask[slot]);
+    if (++slot == SLOTS_PER_DIGIT) {
+        slot = 0;
+        d->digit = (digit + 1) & 3;
+    }
+    d->segment = slot;
+#endif
+
+    PORTD = anodes | (PORTD & ~PIN_ANODES_MASK);
+    PORTC &= ~pgm_read_byte(&cathode[digit]);
+
+#ifdef DISPLAY_LEVELS
+    // held off past the compare value, no match will come; dark for this
+    // slot rather than lit for all of it
+    if (TCNT2 >= OCR2B)
+        display_blank();
+#endif
+}
+
+// Publish through the back framebuffer. Clearing flip first keeps
+// display_update() from switching to the back buffer while it is
+// written; if it switched just before, front is read afterwards.
+// Clearing scroll stops a scrolling text from overwriting the result.
+static void publish(volatile display_t *d, const uint8_t *fb)
+{
+    d->scroll = 0;
+    d->flip = 0;
+    uint8_t back = d->front ^ 1;
+    for (uint8_t i = 0; i < 4; i++)
+        d->fb[back][i] = fb[i];
+    d->flip = 1;
+}
+
+// Render the bcd digits into the framebuffer. Leading zeros are blank
+// up to the decimal point and digit 0, a minus sits left of the number.
+static void render(volatile display_t *d)
+{
+    uint8_t fb[4];
+    int8_t point = d->point - 1;
+    int8_t top;
+
+    // leftmost digit shown
+    for (top = 3; top > 0; top--)
+        if (d->bcd[top] || top <= point)
+            break;
+
+    for (int8_t i = 0; i < 4; i++)
+        fb[i] = i <= top ? glyph('0' + d->bcd[i]) : 0;
+
+    if (d->value < 0 && top < 3)
+        fb[top + 1] = MINUS;
+    if (point >= 0)
+        fb[point] |= DISPLAY_DP;
+
+    publish(d, fb);
+}
+
+// Binary to bcd by repeated subtraction of the powers of ten. At most 27
+// rounds of a 16 bit compare and subtract, no call to __udivmodhi4.
+static void convert(volatile display_t *d, uint16_t v)
+{
+    uint8_t n;
+
+    for (n = 0; v >= 1000; n++)
+        v -= 1000;
+    d->bcd[3] = n;
+    for (n = 0; v >= 100; n++)
+        v -= 100;
+    d->bcd[2] = n;
+    for (n = 0; (uint8_t)v >= 10; n++)
+        v -= 10;
+    d->bcd[1] = n;
+    d->bcd[0] = v;
+}
+
+// Count the bcd digits one up or down, the carry or borrow rarely gets
+// past digit 0.
+static void step(volatile display_t *d, int8_t delta)
+{
+    for (uint8_t i = 0; i < 4; i++) {
+        uint8_t b = d->bcd[i];
+
+        if (delta > 0) {
+            if (b != 9) {
+                d->bcd[i] = b + 1;
+                return;
+            }
+            d->bcd[i] = 0;
+        } else {
+            if (b != 0) {
+                d->bcd[i] = b - 1;
+                return;
+            }
+            d->bcd[i] = 9;
+        }
+    }
+}
+
+void display_set(volatile display_t *d, int value)
+{
+    int v = value;
+
+    if (v < DISPLAY_MIN)
+        v = DISPLAY_MIN;
+    else if (v > DISPLAY_MAX)
+        v = DISPLAY_MAX;
+
+    // step the magnitude when the sign stays the same
+    int old = d->value;
+    int mag = v < 0 ? -v : v;
+    int oldmag = old < 0 ? -old : old;
+
+    if ((v < 0) == (old < 0) && mag == oldmag + 1)
+        step(d, 1);
+    else if ((v < 0) == (old < 0) && mag == oldmag - 1)
+        step(d, -1);
+    else
+        convert(d, mag);
+
+    d->value = v;
+    render(d);
+}
+
+void display_point(volatile display_t *d, int8_t digit)
+{
+    d->point = digit < 0 || digit > 3 ? 0 : digit + 1;
+    if (d->value != DISPLAY_NONE)
+        render(d);
+}
+
+void display_hex(volatile display_t *d, uint16_t value)
+{
+    uint8_t fb[4];
+
+    for (uint8_t i = 0; i < 4; i++) {
+        uint8_t n = value & 0x0f;
+        fb[i] = glyph(n < 10 ? '0' + n : 'A' + n - 10);
+        value >>= 4;
+    }
+
+    publish(d, fb);
+    d->value = DISPLAY_NONE;
+}
+
+static void text(volatile display_t *d, const char *s, uint8_t progmem)
+{
+    uint8_t fb[4];
+    uint8_t n = 0;
+    char c;
+
+    // keep display_update() off text[] while it changes
+    d->scroll = 0;
+
+    while ((c = progmem ? pgm_read_byte(s) : *s) != '\0') {
+        s++;
+        if ((c == '.' || c == ',') && n > 0 && !(d->text[n - 1] & DISPLAY_DP))
+            d->text[n - 1] |= DISPLAY_DP;
+        else if (n < DISPLAY_TEXT_MAX)
+            d->text[n++] = glyph(c);
+    }
+    d->text_len = n;
+
+    // left aligned, digit 3 is leftmost
+    for (uint8_t k = 0; k < 4; k++)
+        fb[3 - k] = k < n ? d->text[k] : 0;
+    publish(d, fb);
+    d->value = DISPLAY_NONE;
+
+    if (n > 4) {
+        d->scroll_pos = 0;
+        d->scroll_count = SCROLL_FRAMES;
+        d->scroll = 1;
+    }
+}
+
+void display_text(volatile display_t *d, const char *s)
+{
+    text(d, s, 0);
+}
+
+void display_text_P(volatile display_t *d, const char *s)
+{
+    text(d, s, 1);
+}
+
+#ifdef DISPLAY_LEVELS
+
+// Turn the brightness of each digit into the TCNT2 value at which
+// display_blank() switches it off.
+static void dim(volatile display_t *d)
+{
+    uint16_t g = pgm_read_word(&gamma[d->level]);
+
+    for (uint8_t i = 0; i < 4; i++) {
+        uint8_t level = DISPLAY_LEVELS - 1 - d->digit_dim[i];
+        uint32_t on = ((uint32_t)g * pgm_read_word(&gamma[level])) >> 16;
+        uint8_t ticks = (on * TIMER2_TICKS + 0xffff) >> 16;
+
+        if (ticks >= TIMER2_TOP) {
+            // lit for the whole slot, TCNT2 never gets past TOP; a match
+            // at TOP would blank the next digit right after it lights
+            d->blank_at[i] = TIMER2_TOP + 1;
+        } else {
+            if (ticks < MIN_TICKS)
+                ticks = MIN_TICKS;
+            d->blank_at[i] = ticks;
+        }
+    }
+}
+
+void display_brightness(volatile display_t *d, uint8_t level)
+{
+    if (level >= DISPLAY_LEVELS)
+        level = DISPLAY_LEVELS - 1;
+    d->level = level;
+    dim(d);
+}
+
+void display_digit_brightness(volatile display_t *d, uint8_t digit, uint8_t level)
+{
+    if (level >= DISPLAY_LEVELS)
+        level = DISPLAY_LEVELS - 1;
+    d->digit_dim[digit & 3] = DISPLAY_LEVELS - 1 - level;
+    dim(d);
+}
+
+void display_auto_brightness(volatile display_t *d, uint16_t adc)
+{
+    // low pass over 16 readings, ambient is 16 times the average
+    uint16_t ambient = d->ambient;
+    ambient += adc - (ambient >> 4);
+    d->ambient = ambient;
+
+    uint8_t level = ambient / (16384 / DISPLAY_LEVELS);
+    if (level != d->level)
+        display_brightness(d, level);
+}
+
+#endif
+
+// The on flag is a single byte only written here and read by
+// display_update(), no critical section needed.
+void display_on(volatile display_t *d, int on)
+{
+    d->on = on;
+}
+
+void display_off(volatile display_t *d)
+{
+    display_on(d, 0);
+}
+
+void display_toggle(volatile display_t *d)
+{
+    display_on(d, !d->on);
+}
@@ -0,0 +1,200 @@
+//
+// display.h
+//
+// Multiplexed 4 digit 7 segment bubble display, anodes A-G on PD0..PD6,
+// digit cathodes 0-3 on PC2..PC5 (see the pinout in bubbledisplay.c).
+//
+// display_set() renders the value into a framebuffer of ready-made PORTD
+// bytes, one per digit, so the refresh interrupt only copies bytes out.
+// Call display_update() from a timer interrupt every DISPLAY_SLOT_US,
+// timer2 in CTC mode with TOP = TIMER2_TOP from timer2conf.h, so the
+// slot length does not depend on interrupt latency.
+// DISPLAY_SCAN selects how much is lit per interrupt:
+//
+//   DISPLAY_SCAN_SEGMENT     one segment, 28 slots per frame. The lowest
+//                            peak current, 1/28 duty cycle per segment.
+//   DISPLAY_SCAN_HALF_DIGIT  segments A-D, then E-G of a digit, 8 slots
+//                            per frame. At most 4 segments share the
+//                            cathode pin.
+//   DISPLAY_SCAN_DIGIT       the whole digit, 4 slots per frame. Up to 7
+//                            segment currents flow through one cathode
+//                            pin, keep them within its 40 mA rating.
+//
+// With 400 us slots a frame takes 11.2 ms (89 Hz) segment by segment,
+// 3.2 ms (312 Hz) by half digits and 1.6 ms (625 Hz) by digits. For the
+// 89 Hz of the segment scan with 7x fewer interrupts use digit scan with
+// 2800 us slots.
+//
+// display_update() cost at -Os, 16 MHz, estimated from the generated
+// code including interrupt entry and exit:
+//
+//   segment scan     ~120 cycles per interrupt, ~3400 cycles per frame
+//   half digit scan   ~85 cycles per interrupt,  ~680 cycles per frame
+//   digit scan        ~75 cycles per interrupt,  ~300 cycles per frame
+//
+// display_set() shows DISPLAY_MIN .. DISPLAY_MAX, other values are
+// clamped; leading zeros are blank and a minus sign sits left of a
+// negative number. display_point() puts a decimal point on one digit
+// of this and the following numbers.
+//
+// display_set() keeps the digits in bcd and converts without division;
+// a change of +1 or -1 only counts the bcd digits, so counting displays
+// can update from an interrupt. Estimated cycles per call,
+// examples/displaybench measures them on the target:
+//
+//                      old % and /   conversion   +1/-1 step
+//   display_set()        ~1500         ~100-300      ~100
+//
+// The framebuffer is double buffered. display_set() renders into the
+// back buffer and flags it, display_update() switches buffers only at a
+// frame boundary, so a frame never mixes two values. Neither side
+// disables interrupts. display_set() must only be called from one
+// context, either the main loop or one interrupt routine.
+//
+// Text: display_text() and display_text_P() (string in flash) show hex
+// digits, most letters and a few symbols from a font in flash, see the
+// table in display.c. A '.' or ',' lights the decimal point of the
+// character before it. Up to 4 characters stand still, left aligned;
+// longer strings, up to DISPLAY_TEXT_MAX characters, are scrolled by
+// display_update() one character every DISPLAY_SCROLL_MS without any
+// help from the main loop, until the next display_set() or text.
+// display_hex() shows 4 hex digits, for status codes.
+//
+// The board has no pin for the decimal point anode; with one on port B,
+// define DISPLAY_DP_PIN, e.g. -DDISPLAY_DP_PIN=PB4. It is lit along
+// with the first slot of its digit. Without it points are not shown.
+//
+// Dimming, with -DDISPLAY_LEVELS=16, 32 or 64: display_update() sets
+// OCR2B to the timer2 count at which the digit goes dark, and the
+// TIMER2_COMPB_vect routine calls display_blank(). Levels go through a
+// gamma 2.2 table, the dimmest level is the shortest lit time that does
+// not race the refresh interrupt, not off. display_brightness() sets
+// all digits, display_digit_brightness() one digit relative to that,
+// display_auto_brightness() follows a light sensor ADC reading.
+// setup_display() starts at full brightness. The refresh rate is
+// unchanged. A refresh held off by other interrupts beyond the compare
+// value leaves that digit dark for one slot. Added cost per slot,
+// within a budget of 40 cycles:
+//
+//   display_update()  ~12 cycles, the OCR2B store and the late check
+//   COMPB interrupt   ~20 cycles, four sbi, no registers saved
+//
+// DISPLAY_STORE_CYCLES (default 60) is the time from the refresh compare
+// match to the OCR2B store, DISPLAY_ISR_DELAY_CYCLES (default 100) the
+// longest other interrupt routine; together they set the dimmest level.
+// With -DDISPLAY_MEASURE display_update() leaves TCNT2 at the store in
+// display_store_ticks, examples/displaybench reports it.
+//
+
+#ifndef DISPLAY_H
+#define DISPLAY_H
+
+#include <avr/io.h>
+#include <stdint.h>
+
+#define DISPLAY_SCAN_SEGMENT 0
+#define DISPLAY_SCAN_HALF_DIGIT 1
+#define DISPLAY_SCAN_DIGIT 2
+
+#ifndef DISPLAY_SCAN
+#define DISPLAY_SCAN DISPLAY_SCAN_SEGMENT
+#endif
+
+#define DISPLAY_MIN -999
+#define DISPLAY_MAX 9999
+
+// display_t.value while a text or hex number is shown
+#define DISPLAY_NONE (DISPLAY_MAX + 2)
+
+// decimal point bit in the framebuffer, not a PORTD anode
+#define DISPLAY_DP 0x80
+
+#ifndef DISPLAY_TEXT_MAX
+#define DISPLAY_TEXT_MAX 12
+#endif
+
+#ifndef DISPLAY_SCROLL_MS
+#define DISPLAY_SCROLL_MS 300
+#endif
+
+#ifndef DISPLAY_SLOT_US
+#define DISPLAY_SLOT_US 400
+#endif
+
+enum {
+    PIN_CATHODE_DIGIT_0 = PC2,
+    PIN_CATHODE_DIGIT_1 = PC3,
+    PIN_CATHODE_DIGIT_2 = PC4,
+    PIN_CATHODE_DIGIT_3 = PC5,
+    PIN_CATHODES_MASK = (_BV(PIN_CATHODE_DIGIT_0) | _BV(PIN_CATHODE_DIGIT_1) |
+                         _BV(PIN_CATHODE_DIGIT_2) | _BV(PIN_CATHODE_DIGIT_3)),
+
+    PIN_ANODE_SEG_A = PD0,
+    PIN_ANODE_SEG_B = PD1,
+    PIN_ANODE_SEG_C = PD2,
+    PIN_ANODE_SEG_D = PD3,
+    PIN_ANODE_SEG_E = PD4,
+    PIN_ANODE_SEG_F = PD5,
+    PIN_ANODE_SEG_G = PD6,
+    PIN_ANODES_MASK = (_BV(PIN_ANODE_SEG_A) | _BV(PIN_ANODE_SEG_B) | _BV(PIN_ANODE_SEG_C) |
+                       _BV(PIN_ANODE_SEG_D) | _BV(PIN_ANODE_SEG_E) | _BV(PIN_ANODE_SEG_F) |
+                       _BV(PIN_ANODE_SEG_G))
+};
+
+typedef struct {
+    uint8_t fb[2][4];   // PORTD anode bits per digit, digit 0 rightmost
+    uint8_t front;      // framebuffer display_update() shows
+    uint8_t flip;       // back framebuffer complete, show it next frame
+    uint8_t bcd[4];     // value in decimal digits, digit 0 rightmost
+    uint8_t digit;
+    uint8_t segment;    // segment or half digit within the digit
+    int value;          // shown number, DISPLAY_NONE for text
+    uint8_t point;      // digit with the decimal point + 1, 0 for none
+    uint8_t on;
+    uint8_t text[DISPLAY_TEXT_MAX];  // glyphs of the text
+    uint8_t text_len;
+    uint8_t scroll;         // text is scrolled by display_update()
+    uint8_t scroll_pos;
+    uint8_t scroll_count;   // frames to the next scroll step
+#ifdef DISPLAY_LEVELS
+    uint8_t level;          // global brightness
+    uint8_t digit_dim[4];   // levels below the global one, per digit
+    uint8_t blank_at[4];    // OCR2B per digit
+    uint16_t ambient;       // filtered light sensor reading
+#endif
+} display_t;
+
+void setup_display(volatile display_t *d);
+
+void display_update(volatile display_t *d);
+
+void display_set(volatile display_t *d, int value);
+void display_point(volatile display_t *d, int8_t digit);
+void display_hex(volatile display_t *d, uint16_t value);
+void display_text(volatile display_t *d, const char *s);
+void display_text_P(volatile display_t *d, const char *s);
+void display_on(volatile display_t *d, int on);
+void display_off(volatile display_t *d);
+void display_toggle(volatile display_t *d);
+
+#ifdef DISPLAY_LEVELS
+#ifdef DISPLAY_MEASURE
+extern volatile uint8_t display_store_ticks;
+#endif
+
+void display_brightness(volatile display_t *d, uint8_t level);
+void display_digit_brightness(volatile display_t *d, uint8_t digit, uint8_t level);
+void display_auto_brightness(volatile display_t *d, uint16_t adc);
+
+// Call from ISR(TIMER2_COMPB_vect). Single bit writes compile to sbi
+// and touch neither registers nor flags.
+static inline void display_blank(void)
+{
+    PORTC |= _BV(PIN_CATHODE_DIGIT_0);
+    PORTC |= _BV(PIN_CATHODE_DIGIT_1);
+    PORTC |= _BV(PIN_CATHODE_DIGIT_2);
+    PORTC |= _BV(PIN_CATHODE_DIGIT_3);
+}
+#endif
+
+#endif
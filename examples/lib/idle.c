@@ -0,0 +1,152 @@
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/power.h>
+#include <avr/sleep.h>
+
+#include "idle.h"
+#include "timer0.h"
+#include "timerwheel.h"
+
+#ifdef IDLE_TICKLESS
+#include "ticks.h"
+
+// timer1 ticks per timer0 count and per timer0 overflow, both timers
+// run off the same prescaler
+#define TICKS_PER_COUNT (64 / TICKS_PRESCALE)
+#define TICKS_PER_OVERFLOW (256L * TICKS_PER_COUNT)
+
+// Longest sleep in timer0 ticks. Half the timer1 range, the other half
+// leaves room for interrupt routines that delay the wake-up.
+#define MAX_TICKS (32768L / TICKS_PER_OVERFLOW)
+
+// The compare only wakes the CPU, idle() does the rest.
+EMPTY_INTERRUPT(TIMER1_COMPA_vect);
+#endif
+
+#ifdef IDLE_STATS
+static unsigned long asleep_us = 0;
+static unsigned long since_us = 0;
+#endif
+
+void setup_idle(void)
+{
+    // none of the examples use TWI or SPI
+    power_twi_disable();
+    power_spi_disable();
+
+    set_sleep_mode(SLEEP_MODE_IDLE);
+
+#ifdef IDLE_STATS
+    since_us = micros();
+#endif
+}
+
+// Called with interrupts disabled, returns with them enabled after the
+// wake-up interrupt has been serviced.
+static void sleep(void)
+{
+    sleep_enable();
+    // the instruction after sei is always executed, the CPU goes to
+    // sleep before any pending interrupt is serviced
+    sei();
+    sleep_cpu();
+    sleep_disable();
+}
+
+#ifdef IDLE_TICKLESS
+// Sleep through the ticks up to the one that makes the next timer due
+// with the timer0 overflow interrupt off, woken by a timer1 compare at
+// that tick or by any other interrupt. Timer0 counts on in idle mode:
+// the distance from the first TCNT0 reading to the last is exact modulo
+// 256, timer1 tells how many times round it went.
+static void sleep_tickless(uint16_t ticks)
+{
+    uint8_t t0, t1;
+    uint16_t start, elapsed, counts;
+
+    if (ticks > MAX_TICKS)
+        ticks = MAX_TICKS;
+
+    // no overflow is pending, idle() checked, so any that happens from
+    // here on is counted below
+    t0 = TCNT0;
+    start = TCNT1;
+    OCR1A = start + (256 - t0 + (ticks - 1) * 256L) * TICKS_PER_COUNT
+        + TICKS_PER_COUNT;
+    TIFR1 = _BV(OCF1A);
+    TIMSK1 |= _BV(OCIE1A);
+    TIMSK0 &= ~_BV(TOIE0);
+
+    sleep();
+
+    cli();
+    TIMSK1 &= ~_BV(OCIE1A);
+
+    // an overflow right after the reading would be cleared below and
+    // lost, wait until TCNT0 has left 255
+    while ((t1 = TCNT0) == 255)
+        ;
+    elapsed = TCNT1 - start;
+    TIFR0 = _BV(TOV0);
+    TIMSK0 |= _BV(TOIE0);
+
+    // nearest count to the timer1 estimate that matches TCNT0
+    counts = elapsed / TICKS_PER_COUNT;
+    counts += (int8_t)(uint8_t)(t1 - t0 - (uint8_t)counts);
+    timer0_catch_up((t0 + counts) >> 8);
+
+    sei();
+}
+#endif
+
+void idle(void)
+{
+#ifdef IDLE_STATS
+    unsigned long t0;
+#endif
+#ifdef IDLE_TICKLESS
+    uint16_t ticks;
+#endif
+
+    cli();
+    if (timerwheel_pending() || (TIFR0 & _BV(TOV0))) {
+        sei();
+        return;
+    }
+
+#ifdef IDLE_STATS
+    t0 = micros();
+#endif
+
+#ifdef IDLE_TICKLESS
+    ticks = timerwheel_next();
+    if (ticks > 1)
+        sleep_tickless(ticks);
+    else
+        sleep();
+#else
+    sleep();
+#endif
+
+#ifdef IDLE_STATS
+    asleep_us += micros() - t0;
+#endif
+}
+
+#ifdef IDLE_STATS
+uint16_t idle_permille(void)
+{
+    unsigned long now = micros();
+    unsigned long total = now - since_us;
+    uint16_t permille = 0;
+
+    // scale both down so the product fits 32 bits
+    if (total >= 1000)
+        permille = asleep_us / (total / 1000);
+
+    asleep_us = 0;
+    since_us = now;
+
+    return permille > 1000 ? 1000 : permille;
+}
+#endif
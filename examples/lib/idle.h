@@ -0,0 +1,52 @@
+//
+// idle.h
+//
+// Sleep between events instead of spinning. Call idle() at the end of
+// the main loop: it puts the CPU into SLEEP_MODE_IDLE until the next
+// interrupt, unless a timer0 tick is already waiting for
+// timerwheel_run(). Checking and sleeping is done with interrupts
+// disabled up to the sleep instruction, so no tick is ever missed. Other
+// work that shows up between the main loop's own checks and idle(), a
+// received byte say, waits for the next wake-up.
+//
+// Plain idle() still wakes up for every timer0 tick, 977 times a second.
+// With -DIDLE_TICKLESS it sleeps through the ticks up to the next
+// timerwheel deadline instead: the timer0 overflow interrupt is switched
+// off and a timer1 compare (OCR1A, TIMER1_COMPA_vect) wakes the CPU one
+// timer0 count after the tick that makes the next timer due. On any
+// wake-up the ticks slept through are added to the millis() and micros()
+// bookkeeping; timer0 keeps counting in idle mode, so the correction is
+// exact and the clock does not drift. One sleep lasts at most 16 ticks
+// at 16 MHz, half the timer1 range. Tickless idle needs timer1 running
+// from setup_ticks() and OCR1A unused, and the main loop must have
+// nothing but timerwheel callbacks and interrupt driven work to do.
+// While it sleeps, interrupt routines see millis() and micros() stand
+// still; nothing in examples/lib reads them from an interrupt.
+//
+// Control latency is unchanged, any interrupt wakes the CPU within a few
+// cycles, and timer callbacks run at most one timer0 count (4 us) after
+// their tick. Power-save would save more: timer2 keeps running in
+// power-save and can wake the CPU from it. But timer2 drives the motor
+// PWM and the display refresh here, and power-save stops the timer1,
+// usart and INT0 edge logic the examples wait on.
+//
+// With -DIDLE_STATS idle() measures the time spent asleep, read it with
+// idle_permille(). This costs two micros() calls per wake-up.
+// tools/idlesim runs this file with a simulated timer0 and timer1 and
+// reports the time asleep and the wake-ups per second.
+//
+
+#ifndef IDLE_H
+#define IDLE_H
+
+#include <stdint.h>
+
+void setup_idle(void);
+void idle(void);
+
+#ifdef IDLE_STATS
+// per mille of the time since the last call spent asleep
+uint16_t idle_permille(void);
+#endif
+
+#endif
@@ -0,0 +1,85 @@
+#include <avr/io.h>
+#include <stdlib.h>
+
+#include "critical.h"
+#include "jitter.h"
+
+static void clear(volatile jitter_t *j)
+{
+    j->min = INT16_MAX;
+    j->max = INT16_MIN;
+    j->sum = 0;
+    j->count = 0;
+    for (uint8_t i = 0; i < JITTER_BINS; i++)
+        j->hist[i] = 0;
+}
+
+void jitter_init(volatile jitter_t *j, uint16_t period)
+{
+    critical_t c = critical_begin();
+
+    j->period = period;
+    j->started = 0;
+    clear(j);
+    critical_end(c);
+}
+
+void jitter_snapshot(volatile jitter_t *j, jitter_t *copy, uint8_t reset)
+{
+    critical_t c = critical_begin();
+
+    copy->period = j->period;
+    copy->last = j->last;
+    copy->started = j->started;
+    copy->min = j->min;
+    copy->max = j->max;
+    copy->sum = j->sum;
+    copy->count = j->count;
+    for (uint8_t i = 0; i < JITTER_BINS; i++)
+        copy->hist[i] = j->hist[i];
+    if (reset)
+        clear(j);
+    critical_end(c);
+}
+
+static void put_string(void (*put)(char c), const char *s)
+{
+    while (*s)
+        put(*s++);
+}
+
+static void put_number(void (*put)(char c), long v)
+{
+    char buf[12];
+
+    put_string(put, ltoa(v, buf, 10));
+}
+
+// "n <count> min <ticks> max <ticks> mean <ticks>" and one line per
+// non-empty histogram bin "<lowest deviation in the bin> <count>",
+// the end bins also hold everything beyond them.
+void jitter_report(const jitter_t *j, void (*put)(char c))
+{
+    put_string(put, "n ");
+    put_number(put, j->count);
+    if (j->count == 0) {
+        put_string(put, "\r\n");
+        return;
+    }
+    put_string(put, " min ");
+    put_number(put, j->min);
+    put_string(put, " max ");
+    put_number(put, j->max);
+    put_string(put, " mean ");
+    put_number(put, j->sum / j->count);
+    put_string(put, "\r\n");
+
+    for (uint8_t i = 0; i < JITTER_BINS; i++) {
+        if (j->hist[i] == 0)
+            continue;
+        put_number(put, ((int)i - JITTER_BINS / 2) * JITTER_BIN_TICKS);
+        put(' ');
+        put_number(put, j->hist[i]);
+        put_string(put, "\r\n");
+    }
+}
@@ -0,0 +1,82 @@
+//
+// jitter.h
+//
+// Interrupt jitter measurement. Call jitter_mark() first thing in the
+// interrupt routine under test; it timestamps the entry with timer1 and
+// records how far the interval since the previous entry is off the
+// nominal period: min, max, mean and a histogram of the deviation.
+// Timer1 has to run free, in normal mode, either from setup_ticks() or
+// undivided for cycle resolution.
+//
+// The mean deviation is the drift of a period built from reloads in
+// software, min and max are the jitter bound. A mark costs about 60
+// cycles in the interrupt, so leave it out of production builds.
+//
+// Read the results with jitter_snapshot(), which copies them with
+// interrupts disabled, and print them with jitter_report(). See
+// examples/jitterbench, which runs on the target and in simavr.
+//
+
+#ifndef JITTER_H
+#define JITTER_H
+
+#include <avr/io.h>
+#include <stdint.h>
+
+// histogram bins, the middle bin holds a deviation of 0
+#ifndef JITTER_BINS
+#define JITTER_BINS 16
+#endif
+
+// timer1 ticks of deviation per bin, a power of two divides cheaply
+#ifndef JITTER_BIN_TICKS
+#define JITTER_BIN_TICKS 1
+#endif
+
+typedef struct {
+    uint16_t period;    // nominal interval in timer1 ticks
+    uint16_t last;      // timer1 at the previous mark
+    uint8_t started;
+    int16_t min;        // deviation from period in ticks
+    int16_t max;
+    int32_t sum;
+    uint16_t count;     // intervals, stops at 0xffff
+    uint16_t hist[JITTER_BINS];
+} jitter_t;
+
+void jitter_init(volatile jitter_t *j, uint16_t period);
+
+static inline void jitter_mark(volatile jitter_t *j)
+{
+    uint16_t now = TCNT1;
+    int16_t dev = (uint16_t)(now - j->last) - j->period;
+
+    j->last = now;
+    if (!j->started) {
+        j->started = 1;
+        return;
+    }
+    if (j->count == 0xffff)
+        return;
+
+    if (dev < j->min)
+        j->min = dev;
+    if (dev > j->max)
+        j->max = dev;
+    j->sum += dev;
+    j->count++;
+
+    // shifted to be positive first, so the division rounds down
+    int16_t bin = dev + JITTER_BINS / 2 * JITTER_BIN_TICKS;
+    if (bin < 0)
+        bin = 0;
+    bin = (uint16_t)bin / JITTER_BIN_TICKS;
+    if (bin >= JITTER_BINS)
+        bin = JITTER_BINS - 1;
+    j->hist[bin]++;
+}
+
+void jitter_snapshot(volatile jitter_t *j, jitter_t *copy, uint8_t reset);
+void jitter_report(const jitter_t *j, void (*put)(char c));
+
+#endif
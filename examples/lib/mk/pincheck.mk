@@ -0,0 +1,24 @@
+# Disassembly check for lib/pin.h: every port access (PINx, DDRx, PORTx of
+# ports B, C and D) in the functions listed in PINCHECK_FUNCS must use the
+# I/O instructions sbi/cbi/in/out/sbis/sbic, never a memory mapped lds/sts.
+# Include at the end of a Makefile and add pincheck to the all target.
+
+PINCHECK_FUNCS ?=
+
+pincheck: main.elf
+	@avr-objdump -d main.elf > pincheck.lst
+	@for f in $(PINCHECK_FUNCS); do \
+	    sed -n "/<$$f>:/,/^$$/p" pincheck.lst > pincheck.fn; \
+	    if [ ! -s pincheck.fn ]; then \
+	        echo "pincheck: $$f not found (inlined?)"; rm -f pincheck.lst pincheck.fn; exit 1; \
+	    fi; \
+	    if grep -E '(lds|sts)[[:space:]].*0x002[3-9ab]([^0-9a-f]|$$)' pincheck.fn; then \
+	        echo "pincheck: $$f accesses a port through lds/sts"; rm -f pincheck.lst pincheck.fn; exit 1; \
+	    fi; \
+	    echo "pincheck: $$f ok," \
+	        "`grep -cE '[[:space:]](sbi|cbi)[[:space:]]' pincheck.fn` sbi/cbi," \
+	        "`grep -cE '[[:space:]](in|out)[[:space:]]' pincheck.fn` in/out"; \
+	done
+	@rm -f pincheck.lst pincheck.fn
+
+.PHONY: pincheck
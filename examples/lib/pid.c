@@ -0,0 +1,72 @@
+#include "pid.h"
+
+static int16_t clamp16(int32_t x)
+{
+    if (x > INT16_MAX)
+        return INT16_MAX;
+    if (x < -INT16_MAX)
+        return -INT16_MAX;
+    return x;
+}
+
+void pid_init(pid_ctrl_t *c, int16_t out_min, int16_t out_max)
+{
+    c->kp = c->ki = c->kd = c->kff = 0;
+    c->offset = 0;
+    c->out_min = out_min;
+    c->out_max = out_max;
+    c->d_shift = 2;
+    pid_reset(c, 0);
+}
+
+void pid_reset(pid_ctrl_t *c, int16_t pv)
+{
+    c->i = 0;
+    c->d = 0;
+    c->prev = pv;
+}
+
+int16_t pid_step(pid_ctrl_t *c, int16_t sp, int16_t pv)
+{
+    int16_t e = clamp16((int32_t)sp - pv);
+    int16_t dpv = clamp16((int32_t)c->prev - pv);
+    int32_t hi = (int32_t)c->out_max * PID_ONE;
+    int32_t lo = (int32_t)c->out_min * PID_ONE;
+    int32_t limit = hi - lo;
+    int32_t u, di;
+
+    c->prev = pv;
+
+    // derivative of -pv, low pass filtered
+    c->d += ((int32_t)c->kd * dpv - c->d) >> c->d_shift;
+
+    u = (int32_t)c->kp * e + c->i + c->d + (int32_t)c->kff * sp;
+    if (sp > 0)
+        u += (int32_t)c->offset * PID_ONE;
+    else if (sp < 0)
+        u -= (int32_t)c->offset * PID_ONE;
+
+    // integrate unless that drives a saturated output further
+    di = (int32_t)c->ki * e;
+    if ((di > 0 && u < hi) || (di < 0 && u > lo)) {
+        int32_t i = c->i;
+
+        c->i += di;
+        // symmetric, feed-forward and offset above the need leave the
+        // integral a negative share to cover
+        if (c->i > limit)
+            c->i = limit;
+        else if (c->i < -limit)
+            c->i = -limit;
+        // only what the clamp let through reaches the output
+        u += c->i - i;
+    }
+
+    if (u > hi)
+        u = hi;
+    else if (u < lo)
+        u = lo;
+
+    // rounded, the shift of a negative value rounds down
+    return (u + PID_ONE / 2) >> 8;
+}
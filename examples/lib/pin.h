@@ -0,0 +1,74 @@
+//
+// pin.h
+//
+// Typed pins without run time cost. A pin is a (direction, port, bit)
+// triple, a pin group a (direction, port, mask) triple:
+//
+//   #define MOTOR_IN1   (OUT, B, 1)
+//   #define BUTTON      (IN, D, 7)
+//   #define MOTOR_DIR   (OUT, B, _BV(1) | _BV(2))
+//
+//   PIN_INIT(MOTOR_IN1);            DDRB |= _BV(1)         sbi
+//   PIN_SET(MOTOR_IN1);             PORTB |= _BV(1)        sbi
+//   PIN_CLEAR(MOTOR_IN1);           PORTB &= ~_BV(1)       cbi
+//   PIN_TOGGLE(MOTOR_IN1);          PINB = _BV(1)          ldi, out
+//   PIN_READ(BUTTON)                PIND & _BV(7)          sbis/sbic or in
+//   PINS_WRITE(MOTOR_DIR, _BV(2));  one read-modify-write  in, andi, or, out
+//
+// All of PORTB, PORTC and PORTD are in the low I/O space, so constant
+// single bit operations compile to one sbi/cbi. The direction is part of
+// the type: PIN_SET, PIN_CLEAR, PIN_TOGGLE and PINS_WRITE only exist for
+// OUT pins and PIN_PULLUP only for IN pins, everything else fails to
+// compile with an undeclared pin_error_... identifier. PIN_INIT sets the
+// data direction register from the same definition.
+//
+// lib/mk/pincheck.mk checks the disassembly of selected functions.
+//
+
+#ifndef PIN_H
+#define PIN_H
+
+#include <avr/io.h>
+
+#define PIN_INIT(p)     PIN_INIT_ p
+#define PIN_SET(p)      PIN_SET_ p
+#define PIN_CLEAR(p)    PIN_CLEAR_ p
+#define PIN_TOGGLE(p)   PIN_TOGGLE_ p
+#define PIN_READ(p)     PIN_READ_ p
+#define PIN_PULLUP(p)   PIN_PULLUP_ p
+
+#define PINS_INIT(g)        PIN_INIT_MASK_ g
+#define PINS_WRITE(g, v)    PINS_WRITE_(PINS_EXPAND_ g, v)
+
+// expand the tuple, then paste the direction
+#define PIN_INIT_(d, port, bit)     PIN_INIT_##d(port, _BV(bit))
+#define PIN_SET_(d, port, bit)      PIN_SET_##d(port, bit)
+#define PIN_CLEAR_(d, port, bit)    PIN_CLEAR_##d(port, bit)
+#define PIN_TOGGLE_(d, port, bit)   PIN_TOGGLE_##d(port, bit)
+#define PIN_READ_(d, port, bit)     (PIN##port & _BV(bit))
+#define PIN_PULLUP_(d, port, bit)   PIN_PULLUP_##d(port, bit)
+
+#define PIN_INIT_MASK_(d, port, mask)   PIN_INIT_##d(port, mask)
+#define PINS_EXPAND_(d, port, mask)     d, port, mask
+#define PINS_WRITE_(...)                PINS_WRITE__(__VA_ARGS__)
+#define PINS_WRITE__(d, port, mask, v)  PINS_WRITE_##d(port, mask, v)
+
+#define PIN_INIT_OUT(port, mask)    (DDR##port |= (mask))
+#define PIN_INIT_IN(port, mask)     (DDR##port &= ~(mask))
+
+#define PIN_SET_OUT(port, bit)      (PORT##port |= _BV(bit))
+#define PIN_CLEAR_OUT(port, bit)    (PORT##port &= ~_BV(bit))
+#define PIN_TOGGLE_OUT(port, bit)   (PIN##port = _BV(bit))
+#define PIN_PULLUP_IN(port, bit)    (PORT##port |= _BV(bit))
+
+#define PINS_WRITE_OUT(port, mask, v) \
+    (PORT##port = (PORT##port & ~(mask)) | ((v) & (mask)))
+
+// misuse, these expand to undeclared identifiers
+#define PIN_SET_IN(port, bit)           pin_error_set_on_input_pin
+#define PIN_CLEAR_IN(port, bit)         pin_error_clear_on_input_pin
+#define PIN_TOGGLE_IN(port, bit)        pin_error_toggle_on_input_pin
+#define PIN_PULLUP_OUT(port, bit)       pin_error_pullup_on_output_pin
+#define PINS_WRITE_IN(port, mask, v)    pin_error_write_on_input_pins
+
+#endif
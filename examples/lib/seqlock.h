@@ -0,0 +1,52 @@
+//
+// seqlock.h
+//
+// Lock-free snapshots of multi-byte results written by one interrupt
+// routine. The routine bumps a sequence counter after it has written the
+// result; the main loop copies the result and copies it again if the
+// counter moved meanwhile:
+//
+//   // interrupt
+//   result.width = w;
+//   result.period = p;
+//   seqlock_write(&seq);
+//
+//   // main loop
+//   seqlock_t s;
+//   do {
+//       s = seqlock_begin(&seq);
+//       copy = result;
+//   } while (seqlock_retry(&seq, s));
+//
+// Interrupts stay enabled, so unlike a critical section the reader adds
+// nothing to the latency of other interrupts. A retry needs another
+// write during the copy, so with writes far apart compared to the copy
+// the loop runs at most twice. The result and the counter must be
+// volatile. The writer runs with interrupts disabled, so it is never
+// seen half way and the counter needs no odd/even state; a single byte
+// is read atomically and only wraps after 256 writes.
+//
+
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <stdint.h>
+
+typedef uint8_t seqlock_t;
+
+static inline void seqlock_write(volatile seqlock_t *seq)
+{
+    (*seq)++;
+}
+
+static inline seqlock_t seqlock_begin(const volatile seqlock_t *seq)
+{
+    return *seq;
+}
+
+static inline uint8_t seqlock_retry(const volatile seqlock_t *seq, seqlock_t s)
+{
+    return *seq != s;
+}
+
+#endif
@@ -0,0 +1,94 @@
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "critical.h"
+#include "tacho.h"
+
+#define TICKS_PER_SEC (TICKS_PER_MHZ * 1000000L)
+#define TIMEOUT_TICKS (TACHO_TIMEOUT_MS * (TICKS_PER_SEC / 1000))
+
+// only written by INT0_vect
+static volatile uint16_t count;
+static volatile uint16_t stamp;
+
+// state of the context that calls tacho_update()
+static uint8_t ppr = 1;
+static uint16_t last_count;
+static uint16_t last_now;       // timer1 at the previous update
+static uint32_t since;          // ticks from the last edge to last_now
+static uint8_t started;         // since is valid
+static uint32_t mhz;
+
+ISR(INT0_vect)
+{
+    // no cli needed for TCNT1, interrupts are off in here
+    stamp = TCNT1;
+    count++;
+}
+
+void setup_tacho(uint8_t pulses)
+{
+    ppr = pulses;
+
+    DDRD &= ~_BV(PD2);
+
+    // INT0 on the rising edge
+    EICRA = (EICRA & ~(_BV(ISC01) | _BV(ISC00))) | _BV(ISC01) | _BV(ISC00);
+    EIFR = _BV(INTF0);
+    EIMSK |= _BV(INT0);
+
+    last_now = TCNT1;
+}
+
+void tacho_set_ppr(uint8_t pulses)
+{
+    ppr = pulses;
+}
+
+void tacho_update(void)
+{
+    uint16_t n, t, now, edges;
+    // also from an interrupt routine that enabled interrupts again, the
+    // INT0 edge and the capture interrupt (timer1 TEMP) may hit here
+    critical_t c = critical_begin();
+
+    n = count;
+    t = stamp;
+    now = TCNT1;
+    critical_end(c);
+
+    edges = n - last_count;
+    last_count = n;
+
+    if (edges == 0) {
+        since += (uint16_t)(now - last_now);
+        if (since > TIMEOUT_TICKS) {
+            started = 0;
+            mhz = 0;
+        }
+    } else {
+        if (started) {
+            // the edges came after last_now, so t - last_now is in range
+            uint32_t span = since + (uint16_t)(t - last_now);
+            uint32_t num = (uint32_t)edges * TICKS_PER_SEC;
+
+            // whole Hz, then the mHz from the remainder
+            mhz = num / span * 1000 + num % span * 1000 / span;
+        }
+        started = 1;
+        since = (uint16_t)(now - t);
+    }
+
+    last_now = now;
+}
+
+uint32_t tacho_mhz(void)
+{
+    return mhz;
+}
+
+// mHz * 60 * 16 / 1000 = mHz * 24 / 25
+uint32_t tacho_rpm(void)
+{
+    return mhz * 24 / (25 * ppr);
+}
@@ -0,0 +1,69 @@
+//
+// tacho.h
+//
+// Speed sensor input on INT0 (PD2): edge frequency and RPM. The
+// interrupt only counts rising edges and timestamps the latest one with
+// the free-running timer1, about 35 cycles per edge. tacho_update(),
+// called every few ms, divides the edges since the
+// previous update by the time between the timestamps of the last edges
+// of both updates, so the gate always spans whole periods:
+//
+//   below the update rate   one edge per gate, a period measurement
+//   above it                many edges per gate, gated counting
+//
+// The same formula covers both, there is no switch, and unlike a fixed
+// gate there is no +-1 count error. The error is the timestamp jitter
+// from interrupt latency: an edge waits for whatever runs with
+// interrupts off, the longest other interrupt routine or critical
+// section. In motorcontrol that is the timer0 overflow, about 100
+// cycles, so the worst case is 6 us over the whole gate and 10 ms
+// updates give better than 0.1 % from 1 Hz up to the tens of kHz; the
+// 32 bit arithmetic holds up to 100 kHz. Every cycle with interrupts off
+// beyond that adds to the error, keep long computations such as
+// pid_step() out of critical sections. The edge interrupt takes 11 % of
+// the CPU at 50 kHz.
+//
+// tacho_update() runs from one place only: the main loop, or an
+// interrupt routine with interrupts enabled again, like the control loop
+// in motorcontrol. Its snapshot of the edge count and timestamp is a
+// nesting-safe critical section, so both work; the results of
+// tacho_mhz() and tacho_rpm() are only consistent in that same context.
+//
+// Without an edge for TACHO_TIMEOUT_MS the speed reads 0, which is also
+// the lowest frequency measured, 1 Hz by default.
+//
+// Timer1 has to run free at TICKS_PER_MHZ, from setup_ticks() or
+// setup_capture(), and tacho_update() has to run at least every 32 ms
+// so timer1 does not wrap twice in between. An update with edges costs
+// about 2000 cycles (three 32 bit divisions).
+//
+
+#ifndef TACHO_H
+#define TACHO_H
+
+#include <stdint.h>
+
+#include "ticks.h"
+
+#ifndef TACHO_TIMEOUT_MS
+#define TACHO_TIMEOUT_MS 1000
+#endif
+
+#if TACHO_TIMEOUT_MS > 2000
+#error TACHO_TIMEOUT_MS must be 2000 at most
+#endif
+
+// fraction bits of tacho_rpm()
+#define TACHO_RPM_SHIFT 4
+
+// pulses per revolution, e.g. the slots of an encoder disc
+void setup_tacho(uint8_t ppr);
+void tacho_set_ppr(uint8_t ppr);
+
+void tacho_update(void);
+
+// of the last update, 0 when stopped
+uint32_t tacho_mhz(void);       // edge frequency in mHz
+uint32_t tacho_rpm(void);       // in 1/16 rpm, >> TACHO_RPM_SHIFT for rpm
+
+#endif
@@ -0,0 +1,95 @@
+#include <stdint.h>
+
+#include "cobs.h"
+#include "crc16.h"
+#include "telemetry.h"
+#include "usart.h"
+
+#if TELEMETRY_MAX_FRAME > 254
+#error TELEMETRY_MAX_PAYLOAD too large for a single COBS block
+#endif
+
+// a full frame plus delimiter must fit into the tx ring
+#if COBS_ENCODED_SIZE(TELEMETRY_MAX_FRAME) + 1 > USART_TX_BUFFER_SIZE - 1
+#error USART_TX_BUFFER_SIZE too small for TELEMETRY_MAX_PAYLOAD
+#endif
+
+void telemetry_init(telemetry_t *t)
+{
+    t->seq = 0;
+    t->len = 0;
+    t->block = 0;
+}
+
+void telemetry_begin(telemetry_t *t, uint16_t timestamp)
+{
+    t->buf[0] = t->seq;
+    t->buf[1] = timestamp & 0xff;
+    t->buf[2] = timestamp >> 8;
+    t->len = TELEMETRY_HEADER_SIZE;
+    t->block = 0;
+}
+
+uint8_t telemetry_add(telemetry_t *t, uint8_t type, uint16_t value)
+{
+    uint8_t len = t->len;
+
+    if (t->block != 0 && (t->buf[t->block] >> 4) == type
+        && (t->buf[t->block] & 0x0f) != TELEMETRY_MAX_BLOCK_COUNT - 1) {
+        // append to the current block
+        if (len + 2 > TELEMETRY_MAX_PAYLOAD)
+            return 0;
+        t->buf[t->block]++;
+    } else {
+        // start a new block
+        if (len + 3 > TELEMETRY_MAX_PAYLOAD)
+            return 0;
+        t->block = len;
+        t->buf[len++] = type << 4;
+    }
+
+    t->buf[len++] = value & 0xff;
+    t->buf[len++] = value >> 8;
+    t->len = len;
+
+    return 1;
+}
+
+// no room for a sample in a new block, header byte and value
+uint8_t telemetry_full(const telemetry_t *t)
+{
+    return t->len + 3 > TELEMETRY_MAX_PAYLOAD;
+}
+
+uint8_t telemetry_send(telemetry_t *t)
+{
+    uint8_t encoded[COBS_ENCODED_SIZE(TELEMETRY_MAX_FRAME)];
+    uint8_t len = t->len;
+    uint8_t n, i;
+    uint16_t crc;
+
+    // nothing to send, keep the sequence number
+    if (len <= TELEMETRY_HEADER_SIZE)
+        return 0;
+
+    // the sequence number advances even if the frame is dropped below,
+    // the host sees the gap
+    t->seq++;
+
+    crc = crc16(t->buf, len);
+    t->buf[len++] = crc & 0xff;
+    t->buf[len++] = crc >> 8;
+    t->len = 0;
+
+    n = cobs_encode(t->buf, len, encoded);
+
+    // whole frames only
+    if (usart_tx_free() < n + 1)
+        return 0;
+
+    for (i = 0; i < n; i++)
+        usart_write(encoded[i]);
+    usart_write(0);
+
+    return 1;
+}
@@ -0,0 +1,59 @@
+//
+// telemetry.h
+//
+// Binary telemetry frames sent through the interrupt driven usart.
+//
+// Frame layout before COBS encoding, multi-byte fields little endian:
+//
+//   seq        uint8_t   incremented for every frame, also dropped ones,
+//                        not for empty sends
+//   timestamp  uint16_t  milliseconds, wraps every 65.5 s
+//   blocks     one or more of
+//                header  uint8_t   type << 4 | (count - 1)
+//                values  uint16_t  count values of that type, 1..16
+//   crc        uint16_t  crc16 over everything above
+//
+// The encoded frame is followed by a single 0x00 delimiter. A full frame
+// of 16 values of one type is 40 bytes on the wire, half of what 16
+// values cost as 4 hex digits plus '\r'.
+//
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+
+#ifndef TELEMETRY_MAX_PAYLOAD
+#define TELEMETRY_MAX_PAYLOAD 64
+#endif
+
+#define TELEMETRY_HEADER_SIZE 3
+#define TELEMETRY_CRC_SIZE 2
+#define TELEMETRY_MAX_BLOCK_COUNT 16
+#define TELEMETRY_MAX_FRAME (TELEMETRY_MAX_PAYLOAD + TELEMETRY_CRC_SIZE)
+
+enum {
+    TELEMETRY_TYPE_PULSEWIDTH = 1,
+    TELEMETRY_TYPE_ADC = 2,
+    TELEMETRY_TYPE_PERIOD = 3,
+    TELEMETRY_TYPE_RPM = 4,
+    TELEMETRY_TYPE_PWM = 5,
+    TELEMETRY_TYPE_IDLE = 6,    // per mille of time asleep, see idle.h
+    TELEMETRY_TYPE_DUTY = 7,    // per mille high, see capture.h
+    TELEMETRY_TYPE_STATS = 8,   // capture statistics, see inputcapture.c
+};
+
+typedef struct {
+    uint8_t buf[TELEMETRY_MAX_FRAME];
+    uint8_t len;
+    uint8_t block;  // index of the current block header, 0 if none
+    uint8_t seq;
+} telemetry_t;
+
+void telemetry_init(telemetry_t *t);
+void telemetry_begin(telemetry_t *t, uint16_t timestamp);
+uint8_t telemetry_add(telemetry_t *t, uint8_t type, uint16_t value);
+uint8_t telemetry_full(const telemetry_t *t);
+uint8_t telemetry_send(telemetry_t *t);
+
+#endif
@@ -0,0 +1,14 @@
+#include <avr/io.h>
+
+#include "ticks.h"
+
+void setup_ticks(void)
+{
+    // normal mode, counts 0 .. 0xffff, no interrupts
+    TCCR1A = 0;
+#if TICKS_PRESCALE == 1
+    TCCR1B = _BV(CS10);
+#else
+    TCCR1B = _BV(CS11); // prescale /8
+#endif
+}
@@ -0,0 +1,51 @@
+//
+// ticks.h
+//
+// Free-running timer1 as a fast 16 bit time base. At 8 and 16 MHz timer1
+// runs at F_CPU / 8 (1 and 0.5 us per tick), at 1 MHz undivided (1 us).
+// The counter wraps every 65536 ticks (32.8 ms at 16 MHz), so it is meant
+// for short intervals measured with unsigned subtraction:
+//
+//   uint16_t t0 = ticks16();
+//   ...
+//   if ((uint16_t)(ticks16() - t0) >= US_TO_TICKS(500))
+//
+// Cost of the time functions at -Os, 16 MHz, including call overhead:
+//
+//   ticks16()    ~4 cycles   inline, no cli, 0.5 us, wraps after 32.8 ms
+//   millis()    ~20 cycles   cli, 1 ms, wraps after 49.7 days
+//   micros()    ~70 cycles   cli, 4 us, wraps after 71.6 minutes
+//   micros64() ~200 cycles   cli, 4 us, does not wrap (2^48 overflows)
+//
+// Reading TCNT1 uses the timer1 TEMP register shared by all 16 bit
+// timer1 registers. ticks16() needs no cli only as long as no interrupt
+// routine reads or writes TCNT1, OCR1x or ICR1; otherwise read it inside
+// a critical section, or use timestamps taken inside that routine.
+//
+
+#ifndef TICKS_H
+#define TICKS_H
+
+#include <avr/io.h>
+#include <stdint.h>
+
+#if F_CPU == 1000000
+#define TICKS_PRESCALE 1
+#elif F_CPU == 8000000 || F_CPU == 16000000
+#define TICKS_PRESCALE 8
+#else
+#error F_CPU not recognized
+#endif
+
+#define TICKS_PER_MHZ (F_CPU / TICKS_PRESCALE / 1000000L)
+#define US_TO_TICKS(us) ((us) * TICKS_PER_MHZ)
+#define TICKS_TO_US(t) ((t) / TICKS_PER_MHZ)
+
+void setup_ticks(void);
+
+static inline uint16_t ticks16(void)
+{
+    return TCNT1;
+}
+
+#endif
@@ -27,8 +27,11 @@ volatile unsigned long timer0_overflow_count = 0;
 volatile unsigned long timer0_millis = 0;
 static unsigned char timer0_fract = 0;
 
+// upper 16 bits of the overflow count, only used by micros64()
+static volatile unsigned int timer0_overflow_count_hi = 0;
 
-ISR(TIMER0_OVF_vect)
+
+static inline void overflow(void)
 {
     // copy these to local variables so they can be stored in registers
     // (volatile variables must be read from memory on every access)
@@ -44,7 +47,19 @@ ISR(TIMER0_OVF_vect)
 
     timer0_fract = f;
     timer0_millis = m;
-    timer0_overflow_count++;
+    if (++timer0_overflow_count == 0)
+	timer0_overflow_count_hi++;
+}
+
+ISR(TIMER0_OVF_vect)
+{
+    overflow();
+}
+
+void timer0_catch_up(unsigned char n)
+{
+    while (n-- > 0)
+	overflow();
 }
 
 unsigned long millis(void)
@@ -83,6 +98,34 @@ unsigned long micros(void)
     return ((m << 8) + t) * (64 / clockCyclesPerMicrosecond());
 }
 
+uint64_t micros64(void)
+{
+    uint64_t m;
+    uint8_t oldSREG = SREG, t;
+
+    cli();
+    m = ((uint64_t)timer0_overflow_count_hi << 32) | timer0_overflow_count;
+    t = TCNT0;
+
+#ifdef TIFR0
+    if ((TIFR0 & _BV(TOV0)) && (t < 255))
+	m++;
+#else
+    if ((TIFR & _BV(TOV0)) && (t < 255))
+	m++;
+#endif
+
+    SREG = oldSREG;
+
+    return ((m << 8) + t) * (64 / clockCyclesPerMicrosecond());
+}
+
+unsigned char timer0_ticks(void)
+{
+    // a single byte load, no cli needed
+    return *(volatile unsigned char *)&timer0_overflow_count;
+}
+
 void setup_timer0(void)
 {
 #if defined(TCCR0) && defined(CS01) && defined(CS00)
@@ -0,0 +1,33 @@
+//
+// timer.h
+//
+// See ticks.h for the cost of each time function.
+//
+
+#ifndef TIMER0_H
+#define TIMER0_H
+
+#include <stdint.h>
+
+// length of one timer0 overflow, 1024 us at 16 MHz; in steps that fit
+// the 32 bit long of avr-gcc, 64 * 256 * 1000000 would not
+#define TIMER0_TICK_US (64L * 256 * 1000 / (F_CPU / 1000))
+#define TIMER0_MS_TO_TICKS(ms) ((ms) * 1000L / TIMER0_TICK_US)
+
+// fails to compile if the above overflowed after all
+typedef char timer0_tick_us_check[TIMER0_TICK_US > 0 ? 1 : -1];
+
+void setup_timer0(void);
+
+unsigned long millis(void);
+unsigned long micros(void);
+uint64_t micros64(void);
+
+// low byte of the overflow count
+unsigned char timer0_ticks(void);
+
+// Count n overflows that passed with the overflow interrupt disabled,
+// see idle.c. Call with interrupts disabled.
+void timer0_catch_up(unsigned char n);
+
+#endif
@@ -0,0 +1,136 @@
+//
+// timer2conf.h
+//
+// Compile time timer2 clock selection. Define one of the inputs before
+// including this file:
+//
+//   TIMER2_PERIOD_US         period of an overflow or compare interrupt
+//   TIMER2_PWM_HZ            frequency of 8 bit fast PWM
+//   TIMER2_PRESCALE_DIVIDER  the prescaler itself
+//
+// and use the outputs, which are plain constants:
+//
+//   TIMER2_PRESCALE   the chosen prescaler
+//   TIMER2_CS_BITS    CS22..CS20 for TCCR2B
+//   TIMER2_TICKS      timer ticks per period (TIMER2_PERIOD_US only)
+//   TIMER2_TOP        OCR2A for CTC mode, TIMER2_TICKS - 1
+//   TIMER2_RELOAD     TCNT2 reload for overflow mode, 256 - TIMER2_TICKS
+//   TIMER2_PERIOD_ERROR_PPM   |achieved - wanted| period in ppm
+//
+// For a period the smallest prescaler that fits 256 ticks is chosen,
+// which gives the finest resolution. The build fails when the achieved
+// period is more than TIMER2_PERIOD_TOL_PPM (default 1000) off and warns
+// when it is not exact. 400 us comes out exact at 1, 8 and 16 MHz (/8 50
+// ticks, /32 100 ticks, /32 200 ticks). For PWM the prescaler giving the
+// closest frequency to TIMER2_PWM_HZ is chosen.
+//
+// Everything is evaluated by the preprocessor, nothing is left to run
+// time but the register writes.
+//
+
+#ifndef TIMER2CONF_H
+#define TIMER2CONF_H
+
+#ifndef F_CPU
+#error F_CPU not defined
+#endif
+
+#if defined(TIMER2_PERIOD_US)
+
+// cpu cycles per period, rounded
+#define TIMER2_CYCLES_ ((1LL * F_CPU * TIMER2_PERIOD_US + 500000) / 1000000)
+
+#if TIMER2_CYCLES_ <= 256
+#define TIMER2_PRESCALE 1
+#elif TIMER2_CYCLES_ <= 256L * 8
+#define TIMER2_PRESCALE 8
+#elif TIMER2_CYCLES_ <= 256L * 32
+#define TIMER2_PRESCALE 32
+#elif TIMER2_CYCLES_ <= 256L * 64
+#define TIMER2_PRESCALE 64
+#elif TIMER2_CYCLES_ <= 256L * 128
+#define TIMER2_PRESCALE 128
+#elif TIMER2_CYCLES_ <= 256L * 256
+#define TIMER2_PRESCALE 256
+#elif TIMER2_CYCLES_ <= 256L * 1024
+#define TIMER2_PRESCALE 1024
+#else
+#error TIMER2_PERIOD_US too long for timer2
+#endif
+
+#define TIMER2_TICKS ((TIMER2_CYCLES_ + TIMER2_PRESCALE / 2) / TIMER2_PRESCALE)
+#define TIMER2_TOP (TIMER2_TICKS - 1)
+#define TIMER2_RELOAD (256 - TIMER2_TICKS)
+
+// achieved period in picoseconds against the wanted one
+#define TIMER2_ACHIEVED_PS_ (TIMER2_TICKS * TIMER2_PRESCALE * 1000000000000 / F_CPU)
+#define TIMER2_WANTED_PS_ (TIMER2_PERIOD_US * 1000000LL)
+#define TIMER2_PERIOD_ERROR_PPM                                         \
+    ((TIMER2_ACHIEVED_PS_ > TIMER2_WANTED_PS_                           \
+      ? TIMER2_ACHIEVED_PS_ - TIMER2_WANTED_PS_                         \
+      : TIMER2_WANTED_PS_ - TIMER2_ACHIEVED_PS_) * 1000000 / TIMER2_WANTED_PS_)
+
+#ifndef TIMER2_PERIOD_TOL_PPM
+#define TIMER2_PERIOD_TOL_PPM 1000
+#endif
+
+#if TIMER2_TICKS < 2
+#error TIMER2_PERIOD_US too short for timer2
+#elif TIMER2_PERIOD_ERROR_PPM > TIMER2_PERIOD_TOL_PPM
+#error TIMER2_PERIOD_US not reachable within TIMER2_PERIOD_TOL_PPM
+#elif (1LL * F_CPU * TIMER2_PERIOD_US) % (1000000LL * TIMER2_PRESCALE) != 0
+#warning TIMER2_PERIOD_US not exact, see TIMER2_PERIOD_ERROR_PPM
+#endif
+
+#elif defined(TIMER2_PWM_HZ)
+
+#define TIMER2_PWM_FREQ_(p) (F_CPU / (256L * (p)))
+// true if prescaler a gets closer to TIMER2_PWM_HZ than the larger b
+#define TIMER2_PWM_CLOSER_(a, b) \
+    (TIMER2_PWM_FREQ_(a) - TIMER2_PWM_HZ < TIMER2_PWM_HZ - TIMER2_PWM_FREQ_(b))
+
+#if TIMER2_PWM_FREQ_(1) <= TIMER2_PWM_HZ
+#define TIMER2_PRESCALE 1
+#elif TIMER2_PWM_FREQ_(8) <= TIMER2_PWM_HZ
+#define TIMER2_PRESCALE (TIMER2_PWM_CLOSER_(1, 8) ? 1 : 8)
+#elif TIMER2_PWM_FREQ_(32) <= TIMER2_PWM_HZ
+#define TIMER2_PRESCALE (TIMER2_PWM_CLOSER_(8, 32) ? 8 : 32)
+#elif TIMER2_PWM_FREQ_(64) <= TIMER2_PWM_HZ
+#define TIMER2_PRESCALE (TIMER2_PWM_CLOSER_(32, 64) ? 32 : 64)
+#elif TIMER2_PWM_FREQ_(128) <= TIMER2_PWM_HZ
+#define TIMER2_PRESCALE (TIMER2_PWM_CLOSER_(64, 128) ? 64 : 128)
+#elif TIMER2_PWM_FREQ_(256) <= TIMER2_PWM_HZ
+#define TIMER2_PRESCALE (TIMER2_PWM_CLOSER_(128, 256) ? 128 : 256)
+#elif TIMER2_PWM_FREQ_(1024) <= TIMER2_PWM_HZ
+#define TIMER2_PRESCALE (TIMER2_PWM_CLOSER_(256, 1024) ? 256 : 1024)
+#else
+#define TIMER2_PRESCALE 1024
+#endif
+
+#elif defined(TIMER2_PRESCALE_DIVIDER)
+
+#define TIMER2_PRESCALE TIMER2_PRESCALE_DIVIDER
+
+#else
+#error define TIMER2_PERIOD_US, TIMER2_PWM_HZ or TIMER2_PRESCALE_DIVIDER
+#endif
+
+#if TIMER2_PRESCALE == 1
+#define TIMER2_CS_BITS (_BV(CS20))
+#elif TIMER2_PRESCALE == 8
+#define TIMER2_CS_BITS (_BV(CS21))
+#elif TIMER2_PRESCALE == 32
+#define TIMER2_CS_BITS (_BV(CS21) | _BV(CS20))
+#elif TIMER2_PRESCALE == 64
+#define TIMER2_CS_BITS (_BV(CS22))
+#elif TIMER2_PRESCALE == 128
+#define TIMER2_CS_BITS (_BV(CS22) | _BV(CS20))
+#elif TIMER2_PRESCALE == 256
+#define TIMER2_CS_BITS (_BV(CS22) | _BV(CS21))
+#elif TIMER2_PRESCALE == 1024
+#define TIMER2_CS_BITS (_BV(CS22) | _BV(CS21) | _BV(CS20))
+#else
+#error TIMER2_PRESCALE_DIVIDER not set correctly
+#endif
+
+#endif
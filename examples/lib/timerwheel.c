@@ -0,0 +1,168 @@
+#include <stdint.h>
+
+#include "timer0.h"
+#include "timerwheel.h"
+
+#if TIMERWHEEL_SLOTS > 128 || (TIMERWHEEL_SLOTS & (TIMERWHEEL_SLOTS - 1))
+#error TIMERWHEEL_SLOTS must be a power of two <= 128
+#endif
+
+#if TIMERWHEEL_POOL_SIZE >= TIMERWHEEL_NONE
+#error TIMERWHEEL_POOL_SIZE too large
+#endif
+
+#define SLOT_MASK (TIMERWHEEL_SLOTS - 1)
+
+// timers that are due in the current tick wait here until they run
+#define SLOT_EXPIRED TIMERWHEEL_SLOTS
+
+typedef struct {
+    timerwheel_fn_t fn;
+    uint16_t expiry;
+    uint16_t period;
+    uint8_t next;
+    uint8_t prev;
+    uint8_t slot;
+} wheel_timer_t;
+
+static wheel_timer_t pool[TIMERWHEEL_POOL_SIZE];
+static uint8_t heads[TIMERWHEEL_SLOTS + 1];
+static uint8_t free_list;
+
+// the tick the wheel has processed up to
+static uint16_t now;
+static uint8_t last_ticks;
+
+static void link(uint8_t i, uint8_t slot)
+{
+    wheel_timer_t *t = &pool[i];
+
+    t->slot = slot;
+    t->prev = TIMERWHEEL_NONE;
+    t->next = heads[slot];
+    if (t->next != TIMERWHEEL_NONE)
+        pool[t->next].prev = i;
+    heads[slot] = i;
+}
+
+static void unlink(uint8_t i)
+{
+    wheel_timer_t *t = &pool[i];
+
+    if (t->prev != TIMERWHEEL_NONE)
+        pool[t->prev].next = t->next;
+    else
+        heads[t->slot] = t->next;
+
+    if (t->next != TIMERWHEEL_NONE)
+        pool[t->next].prev = t->prev;
+}
+
+static void release(uint8_t i)
+{
+    pool[i].fn = 0;
+    pool[i].next = free_list;
+    free_list = i;
+}
+
+void timerwheel_init(void)
+{
+    uint8_t i;
+
+    for (i = 0; i <= TIMERWHEEL_SLOTS; i++)
+        heads[i] = TIMERWHEEL_NONE;
+
+    free_list = TIMERWHEEL_NONE;
+    for (i = 0; i < TIMERWHEEL_POOL_SIZE; i++)
+        release(i);
+
+    now = 0;
+    last_ticks = timer0_ticks();
+}
+
+uint8_t timerwheel_start(uint16_t delay, uint16_t period, timerwheel_fn_t fn)
+{
+    uint8_t i = free_list;
+
+    if (i == TIMERWHEEL_NONE)
+        return TIMERWHEEL_NONE;
+    free_list = pool[i].next;
+
+    if (delay == 0)
+        delay = 1;
+
+    pool[i].fn = fn;
+    pool[i].period = period;
+    pool[i].expiry = now + delay;
+    link(i, pool[i].expiry & SLOT_MASK);
+
+    return i;
+}
+
+void timerwheel_cancel(uint8_t id)
+{
+    if (id < TIMERWHEEL_POOL_SIZE && pool[id].fn) {
+        unlink(id);
+        release(id);
+    }
+}
+
+static void tick(void)
+{
+    uint8_t i, next;
+
+    now++;
+
+    // move everything that is due out of the slot first, callbacks may
+    // start and cancel timers
+    for (i = heads[now & SLOT_MASK]; i != TIMERWHEEL_NONE; i = next) {
+        next = pool[i].next;
+        if (pool[i].expiry == now) {
+            unlink(i);
+            link(i, SLOT_EXPIRED);
+        }
+    }
+
+    while ((i = heads[SLOT_EXPIRED]) != TIMERWHEEL_NONE) {
+        timerwheel_fn_t fn = pool[i].fn;
+
+        unlink(i);
+        if (pool[i].period) {
+            pool[i].expiry += pool[i].period;
+            link(i, pool[i].expiry & SLOT_MASK);
+        } else {
+            release(i);
+        }
+
+        fn();
+    }
+}
+
+uint8_t timerwheel_pending(void)
+{
+    return timer0_ticks() != last_ticks;
+}
+
+uint16_t timerwheel_next(void)
+{
+    uint16_t next = TIMERWHEEL_NEVER;
+    uint8_t i;
+
+    // free timers have no callback
+    for (i = 0; i < TIMERWHEEL_POOL_SIZE; i++) {
+        if (pool[i].fn && (uint16_t)(pool[i].expiry - now) < next)
+            next = pool[i].expiry - now;
+    }
+
+    return next;
+}
+
+void timerwheel_run(void)
+{
+    uint8_t ticks = timer0_ticks();
+
+    while (last_ticks != ticks) {
+        last_ticks++;
+        tick();
+    }
+}
@@ -0,0 +1,57 @@
+//
+// timerwheel.h
+//
+// Hashed timer wheel driven by the timer0 overflow tick (1.024 ms at
+// 16 MHz). One-shot and periodic callbacks from a fixed pool, no heap.
+// Starting and cancelling a timer is O(1): a timer lives in the list of
+// slot (expiry % TIMERWHEEL_SLOTS) and is unlinked in place.
+//
+// The timer0 interrupt routine is not touched. timerwheel_run(), called
+// from the main loop, catches up with the overflow count and runs the
+// callbacks that expired, so callbacks may take as long as they like
+// without adding interrupt latency. It has to be called at least every
+// 255 ticks; a late call only delays callbacks, none are lost.
+//
+// Delays and periods are in ticks, use TIMER0_MS_TO_TICKS(), and must be
+// between 1 and 32767 ticks.
+//
+
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <stdint.h>
+
+#ifndef TIMERWHEEL_SLOTS
+#define TIMERWHEEL_SLOTS 32
+#endif
+
+#ifndef TIMERWHEEL_POOL_SIZE
+#define TIMERWHEEL_POOL_SIZE 8
+#endif
+
+#define TIMERWHEEL_NONE 0xff
+
+typedef void (*timerwheel_fn_t)(void);
+
+void timerwheel_init(void);
+
+// returns a timer id or TIMERWHEEL_NONE if the pool is exhausted,
+// period 0 makes a one-shot timer
+uint8_t timerwheel_start(uint16_t delay, uint16_t period, timerwheel_fn_t fn);
+
+// cancelling an expired one-shot timer is not allowed, its id may
+// already belong to a new timer
+void timerwheel_cancel(uint8_t id);
+
+void timerwheel_run(void);
+
+// true if ticks elapsed since the last timerwheel_run()
+uint8_t timerwheel_pending(void);
+
+// Ticks from the last timerwheel_run() until the next timer is due,
+// TIMERWHEEL_NEVER if none is running. O(TIMERWHEEL_POOL_SIZE), for
+// idle() to sleep through the ticks in between.
+#define TIMERWHEEL_NEVER 0xffff
+uint16_t timerwheel_next(void);
+
+#endif
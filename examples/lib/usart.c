@@ -0,0 +1,185 @@
+#ifndef F_CPU
+#error F_CPU not defined
+#endif
+
+#ifndef BAUD
+#error BAUD not defined
+#endif
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "critical.h"
+#include "usart.h"
+
+// Pick the UBRR value and U2X setting for BAUD at build time. util/setbaud.h
+// only warns when the baud rate is off, here it is an error. Normal speed
+// is preferred because it samples each bit 16 instead of 8 times; double
+// speed is used when it is needed to reach the rate or to get within the
+// tolerance. At 16 MHz 250k, 500k and 1M baud are exact, 1M needs UBRR 0.
+#ifndef BAUD_TOL
+#define BAUD_TOL 2 // percent
+#endif
+
+#define UBRR_1X ((F_CPU + 8L * BAUD) / (16L * BAUD) - 1)
+#define UBRR_2X ((F_CPU + 4L * BAUD) / (8L * BAUD) - 1)
+#define BAUD_1X (F_CPU / (16L * (UBRR_1X + 1)))
+#define BAUD_2X (F_CPU / (8L * (UBRR_2X + 1)))
+#define BAUD_OK(actual) \
+    (100L * ((actual) > BAUD ? (actual) - BAUD : BAUD - (actual)) <= BAUD_TOL * BAUD)
+
+#if UBRR_1X >= 0 && UBRR_1X <= 4095 && BAUD_OK(BAUD_1X)
+#define UBRR_VALUE UBRR_1X
+#define USE_2X 0
+#elif UBRR_2X >= 0 && UBRR_2X <= 4095 && BAUD_OK(BAUD_2X)
+#define UBRR_VALUE UBRR_2X
+#define USE_2X 1
+#else
+#error BAUD not reachable within BAUD_TOL at this F_CPU
+#endif
+
+#if USART_RX_BUFFER_SIZE > 256 || (USART_RX_BUFFER_SIZE & (USART_RX_BUFFER_SIZE - 1))
+#error USART_RX_BUFFER_SIZE must be a power of two <= 256
+#endif
+
+#if USART_TX_BUFFER_SIZE > 256 || (USART_TX_BUFFER_SIZE & (USART_TX_BUFFER_SIZE - 1))
+#error USART_TX_BUFFER_SIZE must be a power of two <= 256
+#endif
+
+#define RX_MASK (USART_RX_BUFFER_SIZE - 1)
+#define TX_MASK (USART_TX_BUFFER_SIZE - 1)
+
+// Each ring has exactly one writer per index: the RX head and the TX tail
+// are only written by the interrupt routines, the RX tail and the TX head
+// only by the main loop. Single byte indices make every access atomic.
+static uint8_t rx_buffer[USART_RX_BUFFER_SIZE];
+static volatile uint8_t rx_head = 0;
+static volatile uint8_t rx_tail = 0;
+
+static uint8_t tx_buffer[USART_TX_BUFFER_SIZE];
+static volatile uint8_t tx_head = 0;
+static volatile uint8_t tx_tail = 0;
+
+static volatile uint16_t rx_overflow_count = 0;
+static uint16_t tx_overflow_count = 0;
+
+ISR(USART_RX_vect)
+{
+    // UCSR0A must be read before UDR0, reading UDR0 clears DOR0
+    uint8_t status = UCSR0A;
+    uint8_t c = UDR0;
+    uint8_t head = rx_head;
+    uint8_t next = (head + 1) & RX_MASK;
+
+    if (status & _BV(DOR0))
+        rx_overflow_count++;
+
+    if (next != rx_tail) {
+        rx_buffer[head] = c;
+        rx_head = next;
+    } else {
+        rx_overflow_count++;
+    }
+}
+
+ISR(USART_UDRE_vect)
+{
+    uint8_t tail = tx_tail;
+
+    if (tail != tx_head) {
+        UDR0 = tx_buffer[tail];
+        tx_tail = (tail + 1) & TX_MASK;
+    } else {
+        // nothing left to send
+        UCSR0B &= ~_BV(UDRIE0);
+    }
+}
+
+void setup_usart(void)
+{
+    UBRR0H = UBRR_VALUE >> 8;
+    UBRR0L = UBRR_VALUE & 0xff;
+#if USE_2X
+    UCSR0A |= _BV(U2X0);
+#else
+    UCSR0A &= ~_BV(U2X0);
+#endif
+
+    // enable tx and rx, rx complete interrupt
+    UCSR0B = _BV(TXEN0) | _BV(RXEN0) | _BV(RXCIE0);
+
+    // 8 data bits
+    UCSR0C = _BV(UCSZ01) | _BV(UCSZ00);
+}
+
+uint8_t usart_available(void)
+{
+    return (rx_head - rx_tail) & RX_MASK;
+}
+
+int usart_read(void)
+{
+    uint8_t tail = rx_tail;
+    uint8_t c;
+
+    if (tail == rx_head)
+        return -1;
+
+    c = rx_buffer[tail];
+    rx_tail = (tail + 1) & RX_MASK;
+
+    return c;
+}
+
+uint8_t usart_tx_free(void)
+{
+    return (tx_tail - tx_head - 1) & TX_MASK;
+}
+
+uint8_t usart_write(uint8_t c)
+{
+    uint8_t head = tx_head;
+    uint8_t next = (head + 1) & TX_MASK;
+
+    if (next == tx_tail) {
+        tx_overflow_count++;
+        return 0;
+    }
+
+    tx_buffer[head] = c;
+    tx_head = next;
+
+    // the UDRE interrupt only ever clears UDRIE0, so setting it here
+    // without disabling interrupts is safe
+    UCSR0B |= _BV(UDRIE0);
+
+    return 1;
+}
+
+uint8_t usart_write_string(const char *s)
+{
+    uint8_t n = 0;
+
+    if (s) {
+        while (*s != '\0' && usart_write(*s++))
+            n++;
+    }
+
+    return n;
+}
+
+uint16_t usart_rx_overflows(void)
+{
+    uint16_t n;
+    critical_t c = critical_begin();
+
+    n = rx_overflow_count;
+    critical_end(c);
+
+    return n;
+}
+
+uint16_t usart_tx_overflows(void)
+{
+    return tx_overflow_count;
+}
@@ -0,0 +1,42 @@
+//
+// usart.h
+//
+// Interrupt driven USART0 with power-of-two RX and TX ring buffers.
+// Nothing in here ever waits on UDRE0 or RXC0: usart_write() drops and
+// counts bytes when the TX buffer is full, usart_read() returns -1 when
+// the RX buffer is empty.
+//
+// BAUD is set at build time (-DBAUD=... in the Makefile). usart.c picks
+// UBRR and U2X and fails the build if the rate is more than BAUD_TOL
+// percent off. At 16 MHz 250000, 500000 and 1000000 baud are exact; at
+// 1 Mbaud a byte arrives every 160 cycles, so keep other interrupt
+// routines short or the hardware overrun (counted as an rx overflow)
+// will trigger.
+//
+
+#ifndef USART_H
+#define USART_H
+
+#include <stdint.h>
+
+#ifndef USART_RX_BUFFER_SIZE
+#define USART_RX_BUFFER_SIZE 32
+#endif
+
+#ifndef USART_TX_BUFFER_SIZE
+#define USART_TX_BUFFER_SIZE 64
+#endif
+
+void setup_usart(void);
+
+uint8_t usart_available(void);
+int usart_read(void);
+
+uint8_t usart_tx_free(void);
+uint8_t usart_write(uint8_t c);
+uint8_t usart_write_string(const char *s);
+
+uint16_t usart_rx_overflows(void);
+uint16_t usart_tx_overflows(void);
+
+#endif
@@ -1,6 +1,17 @@
 #include <avr/io.h>
 #include <avr/interrupt.h>
-#include <util/delay.h>
+#include <avr/pgmspace.h>
+
+#include "capture.h"
+#include "command.h"
+#include "critical.h"
+#include "idle.h"
+#include "pid.h"
+#include "pin.h"
+#include "tacho.h"
+#include "timer0.h"
+#include "timerwheel.h"
+#include "usart.h"
 
 //#define ONE_DIRECTION 
 #define TWO_DIRECTIONS
@@ -11,10 +22,10 @@
 #error Must not define ONE_DIRECTION and TWO_DIRECTIONS
 #endif
 
-#define TIMER1_CLKFUDGE 3
-#define TIMER1_GETVALUE(x) ((x) >> 1)
+// 244.1 Hz at 16 MHz, prescaler /256
+#define TIMER2_PWM_HZ 244
+#include "timer2conf.h"
 
-#define TIMER2_PRESCALE_DIVIDER 256
 #define PWM_MIN 0x40
 #define PWM_MAX 0xff
 
@@ -23,39 +34,105 @@
 #define PULSEWIDTH_MID 1500
 #define PULSEWIDTH_MAX 2000
 
+// widths outside this range count as missing
+#define FAILSAFE_MIN 900
+#define FAILSAFE_MAX 2100
+#define FAILSAFE_FRAMES 3
+#define FAILSAFE_FRAME_MS 20
+
+// speed sensor pulses per revolution
+#define TACHO_PPR 1
+
+// closed loop speed control, gains in 1/256 (see pid.h), tuned with
+// tools/pidsim on a simulated 6000 rpm motor with a 150 ms time constant
+// that starts to turn at PWM_MIN
+#define LOOP_HZ 100
+#define LOOP_TICKS US_TO_TICKS(1000000L / LOOP_HZ)
+#define RPM_MAX 6000
+#define PID_KP 28
+#define PID_KI 1
+#define PID_KD 0
+#define PID_KFF 8
+
 #define BACKWARD 0
 #define FORWARD 1
 
+// RC input on ICP1 (PB0), see capture.h
+// speed sensor on INT0 (PD2), see tacho.h
+#define MOTOR_IN1 (OUT, B, PB1) // L293 input 1
+#define MOTOR_IN2 (OUT, B, PB2) // L293 input 2
+#define MOTOR_EN (OUT, B, PB3)  // L293 enable, OC2A pwm
+#define MOTOR_DIR (OUT, B, _BV(PB1) | _BV(PB2))
+
 // --------------------------
-// TIMER1 - input capture
+// runtime parameters, see command.h
 // --------------------------
 
-volatile uint16_t pulsewidth = 0; // set by TIMER1_CAPT_vect interrupt routine
+static int16_t pwm_min = PWM_MIN;
+static int16_t pwm_max = PWM_MAX;
+static int16_t pulsewidth_margin = PULSEWIDTH_MARGIN;
+static int16_t failsafe_frames = FAILSAFE_FRAMES;
+static int16_t tacho_ppr = TACHO_PPR;
+static int16_t loop_mode = 0; // 1 closed loop
+static int16_t rpm_max = RPM_MAX;
+static int16_t kp = PID_KP;
+static int16_t ki = PID_KI;
+static int16_t kd = PID_KD;
+static int16_t kff = PID_KFF;
 
-ISR(TIMER1_CAPT_vect)
-{
-    uint16_t icr1 = ICR1;
-    TCNT1 = 0;
+// measured, read only
+static int16_t rpm = 0;
+static int16_t cycles = 0; // worst pid_step() with interrupts, 8 cycle resolution
 
-    if (bit_is_set(TCCR1B, ICES1)) {
-        // was rising edge -> set to detect falling edge
-        TCCR1B &= ~_BV(ICES1);
-    } else {
-        pulsewidth = icr1 + TIMER1_CLKFUDGE;
-        // was falling -> now set to detect rising edge
-        TCCR1B |= _BV(ICES1);
-    }
+static const char name_pwm_min[] PROGMEM = "pwm_min";
+static const char name_pwm_max[] PROGMEM = "pwm_max";
+static const char name_margin[] PROGMEM = "margin";
+static const char name_failsafe[] PROGMEM = "failsafe";
+static const char name_ppr[] PROGMEM = "ppr";
+static const char name_rpm[] PROGMEM = "rpm";
+static const char name_closed[] PROGMEM = "closed";
+static const char name_rpm_max[] PROGMEM = "rpm_max";
+static const char name_kp[] PROGMEM = "kp";
+static const char name_ki[] PROGMEM = "ki";
+static const char name_kd[] PROGMEM = "kd";
+static const char name_kff[] PROGMEM = "kff";
+static const char name_cycles[] PROGMEM = "cycles";
+
+static capture_failsafe_t failsafe = {
+    .min = US_TO_TICKS(FAILSAFE_MIN),
+    .max = US_TO_TICKS(FAILSAFE_MAX),
+    .frames = FAILSAFE_FRAMES,
+    .frame_ms = FAILSAFE_FRAME_MS,
+};
+
+static void failsafe_changed(void)
+{
+    failsafe.frames = failsafe_frames;
 }
 
-void setup_timer1(void)
+static void ppr_changed(void)
 {
-    TCCR1A = 0;
+    tacho_set_ppr(tacho_ppr);
+}
 
-    TCCR1B |= _BV(ICES1); // trigger input capture on rising edge
-    TCCR1B |= _BV(CS11);  // set prescaler /8
+static void gains_changed(void);
+static void loop_changed(void);
 
-    TIMSK1 = _BV(ICIE1);  // input capture interrupt enable
-}
+static const command_param_t params[] PROGMEM = {
+    { name_pwm_min, &pwm_min, 0, 0xff, gains_changed },
+    { name_pwm_max, &pwm_max, 0, 0xff, gains_changed },
+    { name_margin, &pulsewidth_margin, 0, 250, NULL },
+    { name_failsafe, &failsafe_frames, 1, 50, failsafe_changed },
+    { name_ppr, &tacho_ppr, 1, 64, ppr_changed },
+    { name_rpm, &rpm, COMMAND_READ_ONLY, NULL },
+    { name_closed, &loop_mode, 0, 1, loop_changed },
+    { name_rpm_max, &rpm_max, 1, 0x7fff, NULL },
+    { name_kp, &kp, 0, PID_GAIN_MAX, gains_changed },
+    { name_ki, &ki, 0, PID_GAIN_MAX, gains_changed },
+    { name_kd, &kd, 0, PID_GAIN_MAX, gains_changed },
+    { name_kff, &kff, 0, PID_GAIN_MAX, gains_changed },
+    { name_cycles, &cycles, COMMAND_READ_ONLY, NULL },
+};
 
 // --------------------------
 // TIMER2 - motor pwm control
@@ -64,45 +141,7 @@ void setup_timer1(void)
 void setup_timer2(void)
 {
     TCCR2A = 0;
-    TCCR2B = 0;
-
-#if F_CPU == 16000000
-#if TIMER2_PRESCALE_DIVIDER == 1
-    // no prescale 
-    TCCR2B &= ~_BV(CS22);
-    TCCR2B &= ~_BV(CS21);
-    TCCR2B |= _BV(CS20);
-#elif TIMER2_PRESCALE_DIVIDER == 8
-    // prescale /8
-    TCCR2B &= ~_BV(CS22);
-    TCCR2B |= _BV(CS21);
-    TCCR2B &= ~_BV(CS20);
-#elif TIMER2_PRESCALE_DIVIDER == 32
-    // prescale /32
-    TCCR2B &= ~_BV(CS22);
-    TCCR2B |= _BV(CS21);
-    TCCR2B |= _BV(CS20);
-#elif TIMER2_PRESCALE_DIVIDER == 64
-    // prescale /64
-    TCCR2B |= _BV(CS22);
-    TCCR2B &= ~_BV(CS21);
-    TCCR2B &= ~_BV(CS20);
-#elif TIMER2_PRESCALE_DIVIDER == 256
-    // prescale /256
-    TCCR2B |= _BV(CS22);
-    TCCR2B |= _BV(CS21);
-    TCCR2B &= ~_BV(CS20);
-#elif TIMER2_PRESCALE_DIVIDER == 1024
-    // prescale /1024
-    TCCR2B |= _BV(CS22);
-    TCCR2B |= _BV(CS21);
-    TCCR2B |= _BV(CS20);
-#else
-#error TIMER2_PRESCALE_DIVIDER not set correctly
-#endif
-#else
-#error F_CPU not recognized
-#endif
+    TCCR2B = TIMER2_CS_BITS;
 
     // fast pwm mode 3
     TCCR2A |= _BV(WGM21) | _BV(WGM20);
@@ -124,13 +163,17 @@ void timer2_set_oc2a(uint8_t ocr2a)
 
 void setup(void)
 {
-    setup_timer1();
+    setup_capture();
+    setup_tacho(TACHO_PPR);
     setup_timer2();
+    setup_usart();
+    command_init(params, sizeof(params) / sizeof(params[0]));
+    setup_timer0();
+    setup_idle();
 
-    DDRB &= ~_BV(PB0); // ICP1 input pin = PB0
-    
     // LD293 control pins
-    DDRB |= _BV(PB1) | _BV(PB2) | _BV(PB3);
+    PINS_INIT(MOTOR_DIR);
+    PIN_INIT(MOTOR_EN);
 }
 
 long map(int x, long in_min, long in_max, long out_min, long out_max)
@@ -140,73 +183,248 @@ long map(int x, long in_min, long in_max, long out_min, long out_max)
 
 void set_motor_pins(int direction, uint8_t pwm)
 {
+    // both direction pins change with a single store
     if (pwm != 0 && direction == BACKWARD) {
-        PORTB &= ~_BV(PB2);
-        PORTB |= _BV(PB1);
+        PINS_WRITE(MOTOR_DIR, _BV(PB1));
     } else if (pwm != 0 && direction == FORWARD) {
-        PORTB &= ~_BV(PB1);
-        PORTB |= _BV(PB2);
+        PINS_WRITE(MOTOR_DIR, _BV(PB2));
     } else {
-        PORTB &= ~_BV(PB1);
-        PORTB &= ~_BV(PB2);
+        PINS_WRITE(MOTOR_DIR, 0);
     }
     timer2_set_oc2a(pwm);
 }
 
 void one_direction(uint16_t reading)
 {
-    if (reading > PULSEWIDTH_MAX - PULSEWIDTH_MARGIN) {
+    if (reading > PULSEWIDTH_MAX - pulsewidth_margin) {
         // full speed
         set_motor_pins(FORWARD, 0xff);
-    } else if (reading < (PULSEWIDTH_MIN + PULSEWIDTH_MARGIN)) {
+    } else if (reading < (PULSEWIDTH_MIN + pulsewidth_margin)) {
         // off
         set_motor_pins(FORWARD, 0);
     } else {
-        set_motor_pins(FORWARD, map(reading, 1000, 2000, PWM_MIN, PWM_MAX));
+        set_motor_pins(FORWARD, map(reading, 1000, 2000, pwm_min, pwm_max));
     }
 }
 
 void two_directions(uint16_t reading)
 {
-    if (reading < PULSEWIDTH_MID - PULSEWIDTH_MARGIN) {
+    if (reading < PULSEWIDTH_MID - pulsewidth_margin) {
         // backward
-        if (reading < PULSEWIDTH_MIN + PULSEWIDTH_MARGIN) {
+        if (reading < PULSEWIDTH_MIN + pulsewidth_margin) {
             // full speed
             set_motor_pins(BACKWARD, 0xff);
         } else {
-            uint8_t pwm = PWM_MAX - map(reading, 1000, 1500, PWM_MIN, PWM_MAX);
+            uint8_t pwm = pwm_max - map(reading, 1000, 1500, pwm_min, pwm_max);
             set_motor_pins(BACKWARD, pwm);
         }
-    } else if (reading > PULSEWIDTH_MID + PULSEWIDTH_MARGIN) {
+    } else if (reading > PULSEWIDTH_MID + pulsewidth_margin) {
         // forward
-        if (reading > PULSEWIDTH_MAX - PULSEWIDTH_MARGIN) {
+        if (reading > PULSEWIDTH_MAX - pulsewidth_margin) {
             // full speed
             set_motor_pins(FORWARD, 0xff);
         } else {
-            set_motor_pins(FORWARD, map(reading, PULSEWIDTH_MID, PULSEWIDTH_MAX, 0x40, 0xff));
+            set_motor_pins(FORWARD, map(reading, PULSEWIDTH_MID, PULSEWIDTH_MAX, pwm_min, pwm_max));
         }
     } else {
         set_motor_pins(FORWARD, 0);
     }
 }
 
-int main(void)
+// --------------------------
+// TIMER1 compare B - closed loop speed control
+// --------------------------
+
+static pid_ctrl_t pid;
+
+// written by the main loop with interrupts disabled
+static volatile uint8_t closed_loop = 0;
+static volatile int16_t loop_setpoint = 0;  // rpm, negative backward
+
+// written by TIMER1_COMPB_vect
+static volatile int16_t loop_rpm = 0;
+static volatile uint16_t loop_ticks_max = 0;
+
+// Runs every LOOP_TICKS on the free-running timer1, next to the input
+// capture: measures the speed and, in closed loop mode, sets the pwm.
+ISR(TIMER1_COMPB_vect)
 {
-    setup();
+    static uint8_t direction = FORWARD;
+    uint8_t dir, pwm;
+    int16_t sp;
+    uint16_t t0, t1;
+    uint32_t r;
+    critical_t c;
+
+    // OCR1B goes through the timer1 TEMP register like ICR1 in the
+    // capture interrupt, so set the next period before enabling them
+    OCR1B += LOOP_TICKS;
     sei();
 
-    PORTB |= _BV(PB2);
+    tacho_update();
+    r = tacho_rpm() >> TACHO_RPM_SHIFT;
+    loop_rpm = r > INT16_MAX ? INT16_MAX : r;
 
-    for (;;) {
-        uint16_t reading = TIMER1_GETVALUE(pulsewidth);
+    if (!closed_loop)
+        return;
+
+    sp = loop_setpoint;
+    dir = sp < 0 ? BACKWARD : FORWARD;
+    if (sp == 0 || dir != direction) {
+        pid_reset(&pid, loop_rpm);
+        direction = dir;
+    }
+    // set_motor_pins() read-modify-writes PORTB and TCCR2A, interrupts
+    // are on again here
+    if (sp == 0) {
+        c = critical_begin();
+        set_motor_pins(FORWARD, 0);
+        critical_end(c);
+        return;
+    }
+
+    // pid_step() runs with interrupts on, a critical section around it
+    // would hold off the tacho edge timestamps, see tacho.h. Only the
+    // TCNT1 reads need one, the capture interrupt shares the TEMP
+    // register. Interrupts in between are timed along, so the worst case
+    // is an upper bound.
+    c = critical_begin();
+    t0 = TCNT1;
+    critical_end(c);
+    pwm = pid_step(&pid, sp < 0 ? -sp : sp, loop_rpm);
+    c = critical_begin();
+    t1 = TCNT1;
+    critical_end(c);
+    if ((uint16_t)(t1 - t0) > loop_ticks_max)
+        loop_ticks_max = t1 - t0;
+
+    c = critical_begin();
+    set_motor_pins(direction, pwm);
+    critical_end(c);
+}
+
+void setup_loop_timer(void)
+{
+    pid_init(&pid, 0, PWM_MAX);
+    gains_changed();
+
+    // timer1 runs free from setup_capture()
+    OCR1B = TCNT1 + LOOP_TICKS;
+    TIFR1 = _BV(OCF1B);
+    TIMSK1 |= _BV(OCIE1B);
+}
+
+static void gains_changed(void)
+{
+    critical_t c = critical_begin();
+
+    pid.kp = kp;
+    pid.ki = ki;
+    pid.kd = kd;
+    pid.kff = kff;
+    pid.offset = pwm_min;
+    pid.out_max = pwm_max;
+    critical_end(c);
+}
+
+static void loop_changed(void)
+{
+    critical_t c = critical_begin();
+
+    pid_reset(&pid, loop_rpm);
+    loop_setpoint = 0;
+    closed_loop = loop_mode;
+    set_motor_pins(FORWARD, 0);
+    critical_end(c);
+}
+
+static void set_setpoint(int16_t sp)
+{
+    critical_t c = critical_begin();
+
+    loop_setpoint = sp;
+    critical_end(c);
+}
+
+// RC pulse width to rpm, the same dead band as the open loop
+int16_t setpoint_rpm(uint16_t reading)
+{
+#if defined(ONE_DIRECTION)
+    if (reading < PULSEWIDTH_MIN + pulsewidth_margin)
+        return 0;
+    if (reading > PULSEWIDTH_MAX)
+        reading = PULSEWIDTH_MAX;
+    return map(reading, PULSEWIDTH_MIN, PULSEWIDTH_MAX, 0, rpm_max);
+#elif defined(TWO_DIRECTIONS)
+    if (reading < PULSEWIDTH_MID - pulsewidth_margin) {
+        if (reading < PULSEWIDTH_MIN)
+            reading = PULSEWIDTH_MIN;
+        return -map(reading, PULSEWIDTH_MID, PULSEWIDTH_MIN, 0, rpm_max);
+    }
+    if (reading > PULSEWIDTH_MID + pulsewidth_margin) {
+        if (reading > PULSEWIDTH_MAX)
+            reading = PULSEWIDTH_MAX;
+        return map(reading, PULSEWIDTH_MID, PULSEWIDTH_MAX, 0, rpm_max);
+    }
+    return 0;
+#endif
+}
+
+static void control(void)
+{
+    capture_t c;
+    uint16_t reading;
+    critical_t s;
+
+    // measurements of the loop interrupt, for get
+    s = critical_begin();
+    rpm = loop_rpm;
+    cycles = loop_ticks_max * TICKS_PRESCALE;
+    critical_end(s);
+
+    capture_get(&c);
+    if (capture_failsafe(&failsafe, &c, millis())) {
+        // no receiver signal, stop the motor
+        set_setpoint(0);
+        if (!closed_loop)
+            set_motor_pins(FORWARD, 0);
+        return;
+    }
+    reading = TICKS_TO_US(c.width);
+
+    if (closed_loop) {
+        set_setpoint(setpoint_rpm(reading));
+        return;
+    }
 
 #if defined(ONE_DIRECTION)
-        one_direction(reading);
+    one_direction(reading);
 #elif defined(TWO_DIRECTIONS)
-        two_directions(reading);
+    two_directions(reading);
 #endif
-        _delay_ms(10);
+}
+
+int main(void)
+{
+    setup();
+    setup_loop_timer();
+    sei();
+
+    PIN_SET(MOTOR_IN2);
+
+    capture_failsafe_init(&failsafe, millis());
+
+    timerwheel_init();
+    timerwheel_start(TIMER0_MS_TO_TICKS(10), TIMER0_MS_TO_TICKS(10), control);
+
+    for (;;) {
+        int c;
+
+        while ((c = usart_read()) >= 0)
+            command_feed(c);
 
+        timerwheel_run();
+        idle();
     }
 
     return 0;
@@ -2,52 +2,16 @@
 #include <avr/interrupt.h>
 #include <util/delay.h>
 
-#define TIMER2_PRESCALE_DIVIDER 8
+// 7812.5 Hz at 16 MHz, prescaler /8
+#define TIMER2_PWM_HZ 7812
+#include "timer2conf.h"
 
 void setup_timer2(void)
 {
     DDRB |= _BV(PB3); // OC2A pin
 
     TCCR2A = 0;
-    TCCR2B = 0;
-
-#if F_CPU == 16000000
-#if TIMER2_PRESCALE_DIVIDER == 1
-    // no prescale 
-    TCCR2B &= ~_BV(CS22);
-    TCCR2B &= ~_BV(CS21);
-    TCCR2B |= _BV(CS20);
-#elif TIMER2_PRESCALE_DIVIDER == 8
-    // prescale /8
-    TCCR2B &= ~_BV(CS22);
-    TCCR2B |= _BV(CS21);
-    TCCR2B &= ~_BV(CS20);
-#elif TIMER2_PRESCALE_DIVIDER == 32
-    // prescale /32
-    TCCR2B &= ~_BV(CS22);
-    TCCR2B |= _BV(CS21);
-    TCCR2B |= _BV(CS20);
-#elif TIMER2_PRESCALE_DIVIDER == 64
-    // prescale /64
-    TCCR2B |= _BV(CS22);
-    TCCR2B &= ~_BV(CS21);
-    TCCR2B &= ~_BV(CS20);
-#elif TIMER2_PRESCALE_DIVIDER == 256
-    // prescale /256
-    TCCR2B |= _BV(CS22);
-    TCCR2B |= _BV(CS21);
-    TCCR2B &= ~_BV(CS20);
-#elif TIMER2_PRESCALE_DIVIDER == 1024
-    // prescale /1024
-    TCCR2B |= _BV(CS22);
-    TCCR2B |= _BV(CS21);
-    TCCR2B |= _BV(CS20);
-#else
-#error TIMER2_PRESCALE_DIVIDER not set correctly
-#endif
-#else
-#error F_CPU not recognized
-#endif
+    TCCR2B = TIMER2_CS_BITS;
 
     // fast pwm mode 3
     TCCR2A |= _BV(WGM21) | _BV(WGM20);
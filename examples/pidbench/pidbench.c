@@ -0,0 +1,125 @@
+// Cycles of pid_step() on the target.
+//
+// Runs pid_step() over setpoints and measurements that take every
+// branch: either sign and zero, errors that saturate the output either
+// way, integrals that hit the clamp, and d_shift 0..4, once with the
+// gains of examples/motorcontrol and once with all gains at
+// PID_GAIN_MAX. Every call is timed alone with interrupts off and
+// timer1 at F_CPU, less the cost of the timing itself. Reports on the
+// serial port:
+//
+//   pid_step <min cycles> <max cycles>
+//   max gains <min cycles> <max cycles>
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <stdlib.h>
+
+#include "usart.h"
+#include "pid.h"
+
+static const int16_t setpoints[] = { 0, 1, -1, 3000, -3000, 6000, 32767, -32767 };
+static const int16_t measurements[] = { 0, 2900, 3000, 3100, 6000, -6000, 32767, -32767 };
+
+#define N_SP (sizeof(setpoints) / sizeof(setpoints[0]))
+#define N_PV (sizeof(measurements) / sizeof(measurements[0]))
+
+static uint16_t overhead;
+
+static uint16_t measure(pid_ctrl_t *c, int16_t sp, int16_t pv)
+{
+    uint16_t t0, t1;
+
+    cli();
+    t0 = TCNT1;
+    pid_step(c, sp, pv);
+    t1 = TCNT1;
+    sei();
+
+    return t1 - t0 - overhead;
+}
+
+static void bench(pid_ctrl_t *c, uint16_t *min, uint16_t *max)
+{
+    *min = 0xffff;
+    *max = 0;
+
+    for (uint8_t shift = 0; shift <= 4; shift++) {
+        c->d_shift = shift;
+        pid_reset(c, 0);
+        // each pair a few times, the integral builds up to its clamp
+        for (uint8_t n = 0; n < 4; n++)
+            for (uint8_t i = 0; i < N_SP; i++)
+                for (uint8_t j = 0; j < N_PV; j++) {
+                    uint16_t t = measure(c, setpoints[i], measurements[j]);
+
+                    if (t < *min)
+                        *min = t;
+                    if (t > *max)
+                        *max = t;
+                }
+    }
+}
+
+static void put(char c)
+{
+    while (!usart_write(c))
+        ;
+}
+
+static void put_string(const char *s)
+{
+    while (*s)
+        put(*s++);
+}
+
+static void put_number(long v)
+{
+    char buf[12];
+
+    put(' ');
+    put_string(ltoa(v, buf, 10));
+}
+
+int main(void)
+{
+    pid_ctrl_t c;
+    uint16_t t0, t1, min, max;
+
+    // timer1 normal mode, no prescaler, one tick per cycle
+    TCCR1A = 0;
+    TCCR1B = _BV(CS10);
+
+    setup_usart();
+    sei();
+
+    cli();
+    t0 = TCNT1;
+    t1 = TCNT1;
+    sei();
+    overhead = t1 - t0;
+
+    // as in examples/motorcontrol
+    pid_init(&c, 0, 0xff);
+    c.kp = 28;
+    c.ki = 1;
+    c.kd = 0;
+    c.kff = 8;
+    c.offset = 0x40;
+    bench(&c, &min, &max);
+    put_string("pid_step");
+    put_number(min);
+    put_number(max);
+
+    c.kp = c.ki = c.kd = c.kff = PID_GAIN_MAX;
+    bench(&c, &min, &max);
+    put_string("\r\nmax gains");
+    put_number(min);
+    put_number(max);
+    put_string("\r\n");
+
+    for (;;)
+        ;
+
+    return 0;
+}
@@ -0,0 +1,63 @@
+// Serial throughput benchmark, the target half of tools/serialbench.
+//
+// Echoes every byte back as fast as the tx ring drains. A byte is only
+// taken out of the rx ring when there is room to echo it, so every byte
+// lost on the target shows up in the rx overflow counter.
+// A lone '\0' is answered with the rx and tx overflow counters as
+// "R<hex> T<hex>\r\n" and is not echoed; the benchmark data never
+// contains zero bytes.
+//
+// Build with e.g. "make BAUD=500000" after "make clean".
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "usart.h"
+
+static char tohex(uint8_t nibble)
+{
+    return nibble < 10
+        ? '0' + nibble
+        : 'A' + nibble - 10;
+}
+
+static void sendhexword(uint16_t word)
+{
+    for (int8_t shift = 12; shift >= 0; shift -= 4)
+        usart_write(tohex((word >> shift) & 0x0f));
+}
+
+static void report(void)
+{
+    usart_write('R');
+    sendhexword(usart_rx_overflows());
+    usart_write(' ');
+    usart_write('T');
+    sendhexword(usart_tx_overflows());
+    usart_write_string("\r\n");
+}
+
+int main(void)
+{
+    DDRB |= _BV(PB0);
+
+    setup_usart();
+    sei();
+
+    for (;;) {
+        int c;
+
+        // keep room for a report
+        if (usart_tx_free() < 16 || (c = usart_read()) < 0)
+            continue;
+
+        if (c == 0) {
+            report();
+        } else {
+            usart_write(c);
+            PINB = _BV(PB0); // toggle PB0 as activity indicator
+        }
+    }
+
+    return 0;
+}
@@ -1,69 +1,49 @@
 #include <avr/io.h>
-#include <string.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
 
-void setupusart(void)
-{
-#ifndef BAUD
-#define BAUD 9600
-#endif
-
-#include <util/setbaud.h>
-
-    UBRR0H = UBRRH_VALUE; // from setbaud.h
-    UBRR0L = UBRRL_VALUE;
-#if USE_2X
-    UCSR0A |= _BV(U2X0);
-#else
-    UCSR0A &= ~_BV(U2X0);
-#endif
+#include "command.h"
+#include "usart.h"
 
-    // enable tx and rx
-    UCSR0B = _BV(TXEN0) | _BV(RXEN0);
+static int16_t led = 0;
 
-    // 8 data bits
-    UCSR0C = _BV(UCSZ01) | _BV(UCSZ00);
-}
-
-void sendbyte(uint8_t data)
+static void led_changed(void)
 {
-    loop_until_bit_is_set(UCSR0A, UDRE0);
-    UDR0 = data;
+    if (led)
+        PORTB |= _BV(PB0);
+    else
+        PORTB &= ~_BV(PB0);
 }
 
-uint8_t receivebyte(void)
-{
-    loop_until_bit_is_set(UCSR0A, RXC0);
-    return UDR0;
-}
+static const char name_led[] PROGMEM = "led";
 
-void sendstring(const char *s)
-{
-    if (s != NULL) {
-        while (*s != '\0')
-            sendbyte(*s++);
-    }
-}
+static const command_param_t params[] PROGMEM = {
+    { name_led, &led, 0, 1, led_changed },
+};
 
 void setup(void)
 {
     DDRB |= _BV(PB0);
     PORTB = 0;
 
-    setupusart();
+    setup_usart();
+    command_init(params, sizeof(params) / sizeof(params[0]));
+    sei();
 }
 
 int main(void)
 {
     setup();
-    sendstring("Hello, Serial Port!\r\n");
+    usart_write_string("Hello, Serial Port!\r\n");
 
     for (;;) {
-        uint8_t c = receivebyte();
-        if (c == '1')
-            PORTB |= _BV(PB0);
-        else if (c == '0')
-            PORTB &= ~_BV(PB0);
-        sendbyte(c);
+        int c = usart_read();
+        if (c < 0)
+            continue;
+
+        // echo, "set led 1" and "set led 0" switch the LED
+        usart_write(c);
+        command_feed(c);
     }
 
     return 0;
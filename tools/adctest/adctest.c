@@ -0,0 +1,297 @@
+//
+// adctest - host checks for the oversampling in examples/lib/adc.c
+//
+// usage: adctest
+//
+// Runs adc.c against a model of the ATmega328P ADC: every call of
+// convert() finishes one conversion and calls ADC_vect. A conversion
+// samples the multiplexer setting it started with; the first ADC_DISCARD
+// conversions after a channel switch and the first ADC_DISCARD_REF after
+// a reference switch read as garbage, so a leak of either shows up in
+// the results. Free running, the next conversion starts as the interrupt
+// is raised, before ADC_vect selects the next channel; on the timer0
+// trigger (adctest-timer0) it starts after.
+//
+// Checks exact results for constant inputs at 10..14 bits, the rounding
+// of the decimation, one result per 4^(b - 10) conversions, the channel
+// divider, and for noisy input with a known true value that every
+// result is within 1 LSB10 of it and the mean is not biased. Prints the
+// failed checks and exits non-zero if there are any.
+//
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+
+#include "adc.h"
+
+#define GARBAGE 1023
+
+static unsigned checks, failed;
+
+#define CHECK(cond, ...)                                \
+    do {                                                \
+        checks++;                                       \
+        if (!(cond)) {                                  \
+            failed++;                                   \
+            printf("%s:%d: ", __FILE__, __LINE__);      \
+            printf(__VA_ARGS__);                        \
+            printf("\n");                               \
+        }                                               \
+    } while (0)
+
+void ADC_vect(void);
+
+// the input of an analog channel, n counts its settled conversions
+typedef uint16_t (*input_t)(uint8_t admux, unsigned long n);
+
+static input_t input;
+static uint8_t sampled;         // ADMUX of the conversion under way
+static uint8_t need;            // garbage conversions after the last switch
+static uint8_t settled;         // conversions since then
+static unsigned long valid[16]; // settled conversions per mux channel
+
+static void start(const adc_channel_t *channels, uint8_t n, input_t in)
+{
+    input = in;
+    for (int i = 0; i < 16; i++)
+        valid[i] = 0;
+    ADMUX = 0x0f;
+    setup_adc(channels, n);
+    // nothing settled since the reference came up
+    sampled = ADMUX;
+    need = ADC_DISCARD_REF;
+    settled = 0;
+    while (adc_read() >= 0)
+        ;
+}
+
+static void switch_to(uint8_t admux)
+{
+    if (admux == sampled)
+        return;
+    need = ((admux ^ sampled) & (_BV(REFS1) | _BV(REFS0))) ? ADC_DISCARD_REF : ADC_DISCARD;
+    settled = 0;
+    sampled = admux;
+}
+
+static void convert(void)
+{
+    if (settled < need) {
+        ADC = GARBAGE;
+    } else {
+        ADC = input(sampled, valid[sampled & 0x0f]);
+        valid[sampled & 0x0f]++;
+    }
+    if (settled < need)
+        settled++;
+
+#if ADC_TRIGGER == ADC_TRIGGER_FREE
+    switch_to(ADMUX);
+    ADC_vect();
+#else
+    ADC_vect();
+    switch_to(ADMUX);
+#endif
+}
+
+static uint16_t constant_value;
+
+static uint16_t constant(uint8_t admux, unsigned long n)
+{
+    // channel 1 reads 900, the others the constant
+    return (admux & 0x0f) == 1 ? 900 : constant_value;
+}
+
+// Constant input: every result is the input scaled by 2^(b - 10), one
+// per 4^(b - 10) settled conversions, on the ring and in the slot.
+static void check_constant(void)
+{
+    for (int bits = 10; bits <= 14; bits++) {
+        const adc_channel_t channels[] PROGMEM = {
+            { ADC_REF_AVCC | 0, 1, ADC_STREAM | (bits > 10 ? ADC_BITS(bits) : 0) },
+        };
+        unsigned long per = 1UL << (2 * (bits - 10));
+        unsigned long results = 0, bad = 0;
+        int v;
+
+        constant_value = 613;
+        start(channels, 1, constant);
+        for (unsigned long i = 0; i < 20 * per + ADC_DISCARD_REF; i++) {
+            convert();
+            while ((v = adc_read()) >= 0) {
+                results++;
+                if (v != 613 << (bits - 10))
+                    bad++;
+            }
+        }
+        CHECK(bad == 0, "%d bits: %lu of %lu results wrong", bits, bad, results);
+        CHECK(results == valid[0] / per, "%d bits: %lu results from %lu conversions",
+              bits, results, valid[0]);
+        CHECK(results == 20, "%d bits: %lu results, expected 20", bits, results);
+        CHECK(adc_value(0) == 613 << (bits - 10), "%d bits: slot %u", bits, adc_value(0));
+    }
+}
+
+static unsigned window_ones;
+
+// the first window_ones conversions of every window of 16 read one higher
+static uint16_t ones(uint8_t admux, unsigned long n)
+{
+    return 400 + (n % 16 < window_ones);
+}
+
+// 12 bits: the sum of 16 conversions shifted by 2, rounded to nearest.
+static void check_rounding(void)
+{
+    const adc_channel_t channels[] PROGMEM = {
+        { ADC_REF_AVCC | 2, 1, ADC_STREAM | ADC_BITS(12) },
+    };
+
+    for (window_ones = 0; window_ones <= 16; window_ones++) {
+        unsigned expect = (unsigned)floor((16 * 400 + window_ones) / 4.0 + 0.5);
+        unsigned long bad = 0, results = 0;
+        int v, wrong = 0;
+
+        start(channels, 1, ones);
+        for (int i = 0; i < 16 * 8 + ADC_DISCARD_REF; i++) {
+            convert();
+            while ((v = adc_read()) >= 0) {
+                results++;
+                if (v != expect) {
+                    bad++;
+                    wrong = v;
+                }
+            }
+        }
+        CHECK(bad == 0 && results == 8, "%u of 16 high: %lu of %lu results wrong, %d for %u",
+              window_ones, bad, results, wrong, expect);
+    }
+}
+
+// Three channels: a 12 bit one on every turn, a plain one every 4th turn
+// and the temperature sensor on the internal reference every 8th, which
+// switches the reference twice per visit. Values are told apart by size.
+static void check_scan(void)
+{
+    const adc_channel_t channels[] PROGMEM = {
+        { ADC_REF_AVCC | 0, 1, ADC_STREAM | ADC_BITS(12) },
+        { ADC_REF_AVCC | 1, 4, ADC_STREAM },
+        { ADC_REF_INTERNAL | ADC_MUX_TEMP, 8, ADC_STREAM | ADC_BITS(11) },
+    };
+    unsigned long n[3] = { 0, 0, 0 }, bad = 0;
+    int v;
+
+    constant_value = 300;
+    start(channels, 3, constant);
+    for (int i = 0; i < 40000; i++) {
+        convert();
+        while ((v = adc_read()) >= 0) {
+            if (v == 1200)
+                n[0]++;
+            else if (v == 900)
+                n[1]++;
+            else if (v == 600)
+                n[2]++;
+            else
+                bad++;
+        }
+    }
+    CHECK(bad == 0, "scan: %lu results wrong", bad);
+    // 12 bits every turn, 16 turns per result, against every 4th turn
+    CHECK(labs((long)n[0] - (long)n[1] / 4) <= 1, "scan: %lu 12 bit and %lu plain results",
+          n[0], n[1]);
+    // 11 bits every 8th turn, 4 turns per result
+    CHECK(labs((long)n[1] - (long)n[2] * 8) <= 8, "scan: %lu plain and %lu 11 bit results",
+          n[1], n[2]);
+    CHECK(adc_value(0) == 1200 && adc_value(1) == 900 && adc_value(2) == 600,
+          "scan: slots %u %u %u", adc_value(0), adc_value(1), adc_value(2));
+    CHECK(adc_overflows() == 0, "scan: %u overflows", adc_overflows());
+}
+
+static uint32_t state = 1;
+
+static uint32_t xorshift(void)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+static double truth;
+
+// the true value with triangular noise of +-1 LSB, quantized
+static uint16_t noisy(uint8_t admux, unsigned long n)
+{
+    double noise = (xorshift() % 65536 + xorshift() % 65536) / 65536.0 - 1.0;
+    long q = lround(truth + noise);
+
+    return q < 0 ? 0 : q > 1023 ? 1023 : q;
+}
+
+// Noisy input: every result within 1 LSB10 of the true value, the mean
+// of each run within 0.25 LSB of it. Over all runs the mean error is
+// what rounding half up leaves, 1 / 2^(b - 9) LSB, a plain shift would
+// be about 0.4 LSB low.
+static void check_noise(void)
+{
+    const int bits_list[] = { 12, 14 };
+
+    for (unsigned b = 0; b < sizeof(bits_list) / sizeof(bits_list[0]); b++) {
+        int bits = bits_list[b];
+        const adc_channel_t channels[] PROGMEM = {
+            { ADC_REF_AVCC | 3, 1, ADC_STREAM | ADC_BITS(bits) },
+        };
+        int scale = 1 << (bits - 10);
+        unsigned long per = 1UL << (2 * (bits - 10));
+        double bias = 0, worst = 0, worst_mean = 0;
+        int runs = 200;
+
+        for (int r = 0; r < runs; r++) {
+            double sum = 0;
+            unsigned long results = 0;
+            int v;
+
+            truth = 2.0 + (xorshift() % 1000000) / 1000000.0 * 1019.0;
+            start(channels, 1, noisy);
+            for (unsigned long i = 0; i < 256 * per + ADC_DISCARD_REF; i++) {
+                convert();
+                while ((v = adc_read()) >= 0) {
+                    double e = v - truth * scale;
+
+                    if (fabs(e) > worst)
+                        worst = fabs(e);
+                    sum += e;
+                    results++;
+                }
+            }
+            CHECK(results == 256, "%d bits: %lu results", bits, results);
+            if (fabs(sum / results) > worst_mean)
+                worst_mean = fabs(sum / results);
+            bias += sum / results / runs;
+        }
+        CHECK(worst <= scale, "%d bits: a result %.2f LSB%d off", bits, worst, bits);
+        CHECK(worst_mean < 0.25 * scale, "%d bits: a run's mean %.2f LSB%d off",
+              bits, worst_mean, bits);
+        CHECK(fabs(bias) < 0.05 * scale, "%d bits: bias %.3f LSB%d", bits, bias, bits);
+        printf("%d bits, noise +-1 LSB10: worst result %.2f, worst mean %.3f, bias %+.3f LSB%d\n",
+               bits, worst, worst_mean, bias, bits);
+    }
+}
+
+int main(void)
+{
+    check_constant();
+    check_rounding();
+    check_scan();
+    check_noise();
+
+    printf("%u checks, %u failed\n", checks, failed);
+
+    return failed ? 1 : 0;
+}
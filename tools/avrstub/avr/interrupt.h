@@ -0,0 +1,13 @@
+#ifndef AVRSTUB_INTERRUPT_H
+#define AVRSTUB_INTERRUPT_H
+
+#include <avr/io.h>
+
+// interrupt routines are plain functions a test can call
+#define ISR(vector, ...) void vector(void); void vector(void)
+#define EMPTY_INTERRUPT(vector) void vector(void) {}
+
+void cli(void);
+void sei(void);
+
+#endif
@@ -0,0 +1,137 @@
+//
+// avr/io.h for host builds of examples/lib
+//
+// The ATmega328P registers the library touches, as plain variables
+// defined in avrstub.c. A test sets them and calls the interrupt
+// routines like functions to play the hardware's part.
+//
+
+#ifndef AVRSTUB_IO_H
+#define AVRSTUB_IO_H
+
+#include <stdint.h>
+
+#define _BV(bit) (1 << (bit))
+#define bit_is_set(sfr, bit) ((sfr) & _BV(bit))
+#define bit_is_clear(sfr, bit) (!((sfr) & _BV(bit)))
+
+extern volatile uint8_t avr_PINB;
+extern volatile uint8_t avr_DDRB;
+extern volatile uint8_t avr_PORTB;
+extern volatile uint8_t avr_PINC;
+extern volatile uint8_t avr_DDRC;
+extern volatile uint8_t avr_PORTC;
+extern volatile uint8_t avr_PIND;
+extern volatile uint8_t avr_DDRD;
+extern volatile uint8_t avr_PORTD;
+extern volatile uint8_t avr_TCCR1A;
+extern volatile uint8_t avr_TCCR1B;
+extern volatile uint8_t avr_TIMSK1;
+extern volatile uint8_t avr_TIFR1;
+extern volatile uint8_t avr_ADMUX;
+extern volatile uint8_t avr_ADCSRA;
+extern volatile uint8_t avr_ADCSRB;
+extern volatile uint8_t avr_DIDR0;
+extern volatile uint8_t avr_EICRA;
+extern volatile uint8_t avr_EIMSK;
+extern volatile uint8_t avr_EIFR;
+extern volatile uint8_t avr_SREG;
+extern volatile uint16_t avr_TCNT1;
+extern volatile uint16_t avr_ICR1;
+extern volatile uint16_t avr_OCR1A;
+extern volatile uint16_t avr_OCR1B;
+extern volatile uint16_t avr_ADC;
+
+#define PINB avr_PINB
+#define DDRB avr_DDRB
+#define PORTB avr_PORTB
+#define PINC avr_PINC
+#define DDRC avr_DDRC
+#define PORTC avr_PORTC
+#define PIND avr_PIND
+#define DDRD avr_DDRD
+#define PORTD avr_PORTD
+#define TCCR1A avr_TCCR1A
+#define TCCR1B avr_TCCR1B
+#define TIMSK1 avr_TIMSK1
+#define TIFR1 avr_TIFR1
+#define ADMUX avr_ADMUX
+#define ADCSRA avr_ADCSRA
+#define ADCSRB avr_ADCSRB
+#define DIDR0 avr_DIDR0
+#define EICRA avr_EICRA
+#define EIMSK avr_EIMSK
+#define EIFR avr_EIFR
+#define SREG avr_SREG
+#define TCNT1 avr_TCNT1
+#define ICR1 avr_ICR1
+#define OCR1A avr_OCR1A
+#define OCR1B avr_OCR1B
+#define ADC avr_ADC
+
+#define PB0 0
+#define PB1 1
+#define PB2 2
+#define PB3 3
+#define PB4 4
+#define PB5 5
+#define PB6 6
+#define PB7 7
+#define PC0 0
+#define PC1 1
+#define PC2 2
+#define PC3 3
+#define PC4 4
+#define PC5 5
+#define PC6 6
+#define PD0 0
+#define PD1 1
+#define PD2 2
+#define PD3 3
+#define PD4 4
+#define PD5 5
+#define PD6 6
+#define PD7 7
+
+#define CS10 0
+#define CS11 1
+#define CS12 2
+#define WGM12 3
+#define WGM13 4
+#define ICES1 6
+#define ICNC1 7
+#define TOIE1 0
+#define OCIE1A 1
+#define OCIE1B 2
+#define ICIE1 5
+#define TOV1 0
+#define OCF1A 1
+#define OCF1B 2
+#define ICF1 5
+
+#define MUX0 0
+#define ADLAR 5
+#define REFS0 6
+#define REFS1 7
+#define ADPS0 0
+#define ADPS1 1
+#define ADPS2 2
+#define ADIE 3
+#define ADIF 4
+#define ADATE 5
+#define ADSC 6
+#define ADEN 7
+#define ADTS0 0
+#define ADTS1 1
+#define ADTS2 2
+
+#define ISC00 0
+#define ISC01 1
+#define ISC10 2
+#define ISC11 3
+#define INT0 0
+#define INT1 1
+#define INTF0 0
+#define INTF1 1
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef AVRSTUB_PGMSPACE_H
+#define AVRSTUB_PGMSPACE_H
+
+#include <stdint.h>
+
+// flash is ordinary memory on the host
+#define PROGMEM
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#define pgm_read_word(p) (*(const uint16_t *)(p))
+
+#endif
@@ -0,0 +1,44 @@
+//
+// avrstub.c - the registers of avr/io.h and cli()/sei() for host builds
+//
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+volatile uint8_t avr_PINB;
+volatile uint8_t avr_DDRB;
+volatile uint8_t avr_PORTB;
+volatile uint8_t avr_PINC;
+volatile uint8_t avr_DDRC;
+volatile uint8_t avr_PORTC;
+volatile uint8_t avr_PIND;
+volatile uint8_t avr_DDRD;
+volatile uint8_t avr_PORTD;
+volatile uint8_t avr_TCCR1A;
+volatile uint8_t avr_TCCR1B;
+volatile uint8_t avr_TIMSK1;
+volatile uint8_t avr_TIFR1;
+volatile uint8_t avr_ADMUX;
+volatile uint8_t avr_ADCSRA;
+volatile uint8_t avr_ADCSRB;
+volatile uint8_t avr_DIDR0;
+volatile uint8_t avr_EICRA;
+volatile uint8_t avr_EIMSK;
+volatile uint8_t avr_EIFR;
+volatile uint8_t avr_SREG;
+volatile uint16_t avr_TCNT1;
+volatile uint16_t avr_ICR1;
+volatile uint16_t avr_OCR1A;
+volatile uint16_t avr_OCR1B;
+volatile uint16_t avr_ADC;
+
+// the I bit of SREG, so critical sections can be checked
+void cli(void)
+{
+    SREG &= ~0x80;
+}
+
+void sei(void)
+{
+    SREG |= 0x80;
+}
@@ -0,0 +1,241 @@
+//
+// capturetest - host checks for the PWM capture read and the failsafe
+//
+// usage: capturetest
+//
+// Runs examples/lib/capture.c in CAPTURE_PWM mode against the registers
+// of tools/avrstub; an edge is ICR1 set to its timestamp and a call of
+// TIMER1_CAPT_vect, which flips ICES1 for the next edge as on the chip.
+//
+// Lock-free read: an interval timer sends a signal every 20 us and the
+// handler plays the next edge, so the capture interrupt lands anywhere
+// in capture_get() like on the chip. Width and period of every pulse are
+// tied to its number, a pair from two different pulses shows. The check
+// also counts the reads an edge interrupted, to show it tested something.
+//
+// Failsafe: 20 ms frames of 1500 us pulses on a simulated millisecond
+// clock near the 16 bit wrap, capture_failsafe() called every ms with
+// frames = 3. Checks that it starts failed and clears with the first
+// valid pulse, rides out two missing frames, fails exactly frames *
+// frame_ms after the last valid pulse when the signal stops or its
+// pulses go out of range, and recovers with the next valid pulse.
+// Prints the failed checks and exits non-zero if there are any.
+//
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/time.h>
+#include <time.h>
+
+#include <avr/interrupt.h>
+
+#include "capture.h"
+
+static unsigned checks, failed;
+
+#define CHECK(cond, ...)                                \
+    do {                                                \
+        checks++;                                       \
+        if (!(cond)) {                                  \
+            failed++;                                   \
+            printf("%s:%d: ", __FILE__, __LINE__);      \
+            printf(__VA_ARGS__);                        \
+            printf("\n");                               \
+        }                                               \
+    } while (0)
+
+void TIMER1_CAPT_vect(void);
+
+static void edge(uint16_t t)
+{
+    ICR1 = t;
+    TIMER1_CAPT_vect();
+}
+
+// pulse k: a period and a width that both follow from k
+#define WIDTH(k) (2000 + 7 * ((k) % 1000))
+#define PERIOD(k) (30000 + 3 * ((k) % 1000))
+
+static volatile unsigned long pulse;    // pulses completed
+static volatile uint16_t rise;
+static volatile unsigned long edges;
+
+static void on_signal(int sig)
+{
+    unsigned long k = pulse;
+
+    if (bit_is_set(TCCR1B, ICES1)) {
+        rise += PERIOD(k);
+        edge(rise);
+    } else {
+        edge(rise + WIDTH(k));
+        pulse = k + 1;
+    }
+    edges++;
+}
+
+static void check_read(void)
+{
+    struct sigaction sa = { .sa_handler = on_signal };
+    struct itimerval every = { { 0, 20 }, { 0, 20 } }, off = { { 0, 0 }, { 0, 0 } };
+    unsigned long reads = 0, interrupted = 0, mixed = 0, stale = 0;
+    time_t end;
+    capture_t c;
+
+    setup_capture();
+    sigaction(SIGALRM, &sa, 0);
+    setitimer(ITIMER_REAL, &every, 0);
+
+    end = time(0) + 2;
+    while (time(0) < end || interrupted < 1000) {
+        unsigned long before = edges, after, p;
+        unsigned long k;
+
+        capture_get(&c);
+        p = pulse;
+        after = edges;
+        reads++;
+        if (after != before)
+            interrupted++;
+        if (c.period == 0)
+            continue;
+
+        // the pulse the width belongs to
+        k = (c.width - 2000) / 7;
+        if (c.width != WIDTH(k) || c.period != PERIOD(k))
+            mixed++;
+        // count is the seqlock, moved by every complete pulse
+        if (after == before && c.count != (uint8_t)p)
+            stale++;
+        if (time(0) > end + 10)
+            break;
+    }
+
+    setitimer(ITIMER_REAL, &off, 0);
+
+    CHECK(mixed == 0, "%lu of %lu reads mix two pulses", mixed, reads);
+    CHECK(stale == 0, "%lu of %lu reads with a wrong count", stale, reads);
+    CHECK(interrupted >= 1000, "only %lu reads interrupted by an edge", interrupted);
+    CHECK(pulse > 1000, "only %lu pulses", pulse);
+    printf("capture_get: %lu reads, %lu interrupted by an edge, %lu pulses, %lu mixed\n",
+           reads, interrupted, pulse, mixed);
+}
+
+// simulated milliseconds, started close to the wrap of millis() & 0xffff
+static uint16_t now;
+static uint16_t ticks;
+
+static void pulse_at(uint16_t width_us)
+{
+    uint16_t t = ticks + (uint16_t)(now * US_TO_TICKS(1000L));
+
+    edge(t);
+    edge(t + US_TO_TICKS(width_us));
+}
+
+#define FRAMES 3
+#define FRAME_MS 20
+
+static capture_failsafe_t failsafe = {
+    .min = US_TO_TICKS(900), .max = US_TO_TICKS(2100),
+    .frames = FRAMES, .frame_ms = FRAME_MS,
+};
+
+// Run to stop, a pulse of width_us (0 for none) every 20 ms unless
+// skipped, and return the first time the failsafe state changed,
+// -1 if it did not; state ends as the last call returned.
+static long run(uint16_t stop, uint16_t width_us, uint8_t skip_from, uint8_t skip_to,
+                uint8_t *state)
+{
+    long changed = -1;
+    uint8_t frame = 0, r;
+    capture_t c;
+
+    while (now != stop) {
+        if (now % FRAME_MS == 0) {
+            if (width_us && (frame < skip_from || frame >= skip_to))
+                pulse_at(width_us);
+            frame++;
+        }
+        capture_get(&c);
+        r = capture_failsafe(&failsafe, &c, now);
+        if (r != *state) {
+            if (changed < 0)
+                changed = now;
+            *state = r;
+        }
+        now++;
+    }
+    return changed;
+}
+
+static void check_failsafe(void)
+{
+    uint8_t state = 1;
+    uint16_t last;
+    long t;
+
+    setup_capture();
+    ticks = 12345;
+    now = 65000;
+    capture_failsafe_init(&failsafe, now);
+
+    // failed until the first valid pulse; the first pulse has no period
+    // but a width, which is all the failsafe looks at
+    t = run(65100, 0, 0, 0, &state);
+    CHECK(t == -1 && state == 1, "failsafe %u without a signal, changed at %ld", state, t);
+    t = run(65200, 1500, 0, 0, &state);
+    CHECK(t == 65100 && state == 0, "first pulse at 65100, failsafe %u at %ld", state, t);
+
+    // across the wrap of the clock, two frames missing are tolerated
+    t = run(400, 1500, 10, 10 + FRAMES - 1, &state);
+    CHECK(t == -1 && state == 0, "%d frames missing: failsafe at %ld", FRAMES - 1, t);
+
+    // three are not: fails at the first call more than 60 ms after the
+    // last valid pulse
+    last = now - FRAME_MS;
+    t = run(600, 1500, 0, FRAMES, &state);
+    CHECK(t == (uint16_t)(last + FRAMES * FRAME_MS + 1) && state == 0,
+          "%d frames missing after %u: failsafe at %ld, back %u", FRAMES, last, t, state);
+
+    // and so is a signal that stops, until it comes back
+    last = now - FRAME_MS;
+    t = run(700, 0, 0, 0, &state);
+    CHECK(t == (uint16_t)(last + FRAMES * FRAME_MS + 1) && state == 1,
+          "signal lost after %u: failsafe at %ld", last, t);
+    CHECK(t - last == FRAMES * FRAME_MS + 1, "reaction %ld ms", t - last);
+    t = run(800, 1500, 0, 0, &state);
+    CHECK(t == 700 && state == 0, "signal back at 700: cleared at %ld", t);
+
+    // pulses out of range count as none
+    last = now - FRAME_MS;
+    t = run(1000, 500, 0, 0, &state);
+    CHECK(t == last + FRAMES * FRAME_MS + 1 && state == 1,
+          "500 us pulses after %u: failsafe at %ld", last, t);
+    t = run(1100, 2500, 0, 0, &state);
+    CHECK(t == -1 && state == 1, "2500 us pulses: failsafe %u, changed at %ld", state, t);
+    t = run(1200, 2100, 0, 0, &state);
+    CHECK(t == 1100 && state == 0, "2100 us pulse at 1100: cleared at %ld", t);
+
+    // and a signal that stops after a single pulse
+    last = 1200;
+    t = run(1300, 1000, 1, 255, &state);
+    CHECK(t == last + FRAMES * FRAME_MS + 1 && state == 1,
+          "one pulse at %u: failsafe at %ld", last, t);
+
+    printf("failsafe: %d ms after the last valid pulse with %d ms calls\n",
+           FRAMES * FRAME_MS + 1, 1);
+}
+
+int main(void)
+{
+    check_read();
+    check_failsafe();
+
+    printf("%u checks, %u failed\n", checks, failed);
+
+    return failed ? 1 : 0;
+}
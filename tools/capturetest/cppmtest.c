@@ -0,0 +1,303 @@
+//
+// cppmtest - host checks for the CPPM decoder of examples/lib/capture.c
+//
+// usage: cppmtest
+//
+// Runs capture.c in CAPTURE_CPPM mode against the registers of
+// tools/avrstub with synthetic pulse trains: a rising edge is ICR1 set
+// to its timestamp and a call of TIMER1_CAPT_vect. A frame is an edge
+// per channel, its value the time from the edge before, then a gap
+// longer than CAPTURE_SYNC_US to the edge that starts the next frame.
+//
+// Checks that edges before the first sync gap are ignored; that valid
+// frames of 4..8 channels come out exact, with the frame length as the
+// period, across the wrap of timer1; that short frames, frames with one
+// slot too many, slots out of range, a glitch splitting a slot and a
+// lost sync gap are counted as corrupt and leave the last good frame in
+// place; that the statistics (CAPTURE_STATS) take only channels of
+// valid frames and count the bad slots as dropped; and, with an interval
+// timer playing an edge every 20 us, that capture_frame() never returns
+// channels of two different frames.
+// Prints the failed checks and exits non-zero if there are any.
+//
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/time.h>
+#include <time.h>
+
+#include <avr/interrupt.h>
+
+#include "capture.h"
+
+static unsigned checks, failed;
+
+#define CHECK(cond, ...)                                \
+    do {                                                \
+        checks++;                                       \
+        if (!(cond)) {                                  \
+            failed++;                                   \
+            printf("%s:%d: ", __FILE__, __LINE__);      \
+            printf(__VA_ARGS__);                        \
+            printf("\n");                               \
+        }                                               \
+    } while (0)
+
+void TIMER1_CAPT_vect(void);
+
+static uint16_t t;      // timer1 at the last edge
+
+static void edge_after(uint16_t us)
+{
+    t += US_TO_TICKS(us);
+    ICR1 = t;
+    TIMER1_CAPT_vect();
+}
+
+// The channels, then the sync gap; the edge after the gap publishes the
+// frame, it is also the start of the next one.
+static void frame(const uint16_t *us, uint8_t n, uint16_t gap_us)
+{
+    for (uint8_t i = 0; i < n; i++)
+        edge_after(us[i]);
+    edge_after(gap_us);
+}
+
+static uint16_t frame_us(const uint16_t *us, uint8_t n, uint16_t gap_us)
+{
+    uint16_t sum = gap_us;
+
+    for (uint8_t i = 0; i < n; i++)
+        sum += us[i];
+    return sum;
+}
+
+// the front frame holds exactly these channels
+static int holds(const uint16_t *us, uint8_t n)
+{
+    capture_frame_t f;
+
+    capture_frame(&f);
+    if (f.n != n)
+        return 0;
+    for (uint8_t i = 0; i < n; i++)
+        if (f.ch[i] != US_TO_TICKS(us[i]))
+            return 0;
+    return 1;
+}
+
+static unsigned hist_sum(const capstats_t *s)
+{
+    unsigned n = 0;
+
+    for (int i = 0; i < CAPSTATS_BINS; i++)
+        n += s->hist[i];
+    return n;
+}
+
+static void check_frames(void)
+{
+    uint16_t good[8] = { 1500, 1000, 2000, 1200, 1800, 1100, 1900, 1500 };
+    uint16_t us[10];
+    capture_frame_t f;
+    capture_t c;
+    capstats_t stats;
+    uint16_t corrupt;
+    uint8_t count;
+
+    setup_capture();
+    t = 60000;
+
+    // nothing before the first sync gap
+    for (int i = 0; i < 20; i++)
+        edge_after(1000 + 50 * i);
+    capture_frame(&f);
+    CHECK(f.n == 0 && capture_corrupt() == 0, "before sync: %u channels, %u corrupt",
+          f.n, capture_corrupt());
+    edge_after(5000);
+    capture_frame(&f);
+    CHECK(f.n == 0 && capture_corrupt() == 0, "first gap: %u channels, %u corrupt",
+          f.n, capture_corrupt());
+    count = f.count;
+
+    // 200 frames, timer1 wraps about every third; values and gap vary
+    for (int k = 0; k < 200; k++) {
+        uint16_t gap = 3000 + (k * 97) % 4000;
+
+        for (int i = 0; i < 8; i++)
+            us[i] = 1000 + (k * 37 + i * 111) % 1001;
+        frame(us, 8, gap);
+
+        capture_frame(&f);
+        capture_get(&c);
+        CHECK(holds(us, 8), "frame %d: channels wrong", k);
+        CHECK(f.count == (uint8_t)(count + k + 1), "frame %d: count %u", k, f.count);
+        CHECK(c.width == US_TO_TICKS(us[0]) && c.period == US_TO_TICKS(frame_us(us, 8, gap)),
+              "frame %d: width %u period %u", k, c.width, c.period);
+    }
+    CHECK(capture_corrupt() == 0, "%u corrupt of 200 good frames", capture_corrupt());
+
+    // CAPTURE_MIN_CHANNELS is the shortest valid frame
+    frame(good, 4, 10000);
+    CHECK(holds(good, 4), "4 channel frame not decoded");
+    frame(good, 8, 4000);
+    CHECK(holds(good, 8), "8 channel frame not decoded");
+    for (int i = 0; i < 8; i++)
+        capture_stats(i, &stats, 1);
+
+    // every corrupt frame is counted and keeps the last good one
+    corrupt = capture_corrupt();
+    capture_frame(&f);
+    count = f.count;
+
+    frame(good, 3, 10000);
+    CHECK(capture_corrupt() == corrupt + 1 && holds(good, 8), "3 channel frame");
+
+    for (int i = 0; i < 9; i++)
+        us[i] = 1500;
+    frame(us, 9, 4000);
+    CHECK(capture_corrupt() == corrupt + 2 && holds(good, 8), "9 channel frame");
+
+    for (int i = 0; i < 8; i++)
+        us[i] = good[i];
+    us[3] = 650;
+    frame(us, 8, 4000);
+    CHECK(capture_corrupt() == corrupt + 3 && holds(good, 8), "650 us slot");
+
+    us[3] = 2350;
+    frame(us, 8, 4000);
+    CHECK(capture_corrupt() == corrupt + 4 && holds(good, 8), "2350 us slot");
+
+    // a glitch splits a 1500 us slot, the pieces are out of range
+    us[3] = 300;
+    us[4] = 1200;
+    for (int i = 5; i < 9; i++)
+        us[i] = good[i - 1];
+    frame(us, 9, 4000);
+    CHECK(capture_corrupt() == corrupt + 5 && holds(good, 8), "glitch");
+
+    // a gap too short for sync runs two frames together
+    for (int i = 0; i < 8; i++)
+        us[i] = good[i];
+    frame(us, 8, 2300);
+    frame(us, 8, 4000);
+    CHECK(capture_corrupt() == corrupt + 6 && holds(good, 8), "lost sync");
+
+    capture_frame(&f);
+    CHECK(f.count == count, "corrupt frames moved the count by %u", (uint8_t)(f.count - count));
+
+    // the next good frame is decoded again
+    for (int i = 0; i < 8; i++)
+        us[i] = 2000 - (good[i] - 1000);
+    frame(us, 8, 4000);
+    CHECK(holds(us, 8), "no good frame after the corrupt ones");
+    CHECK(capture_corrupt() == corrupt + 6, "good frame counted as corrupt");
+
+    // the statistics hold the good frame from before the corrupt ones,
+    // no corrupt slot; the last frame goes in with the next one
+    for (int i = 0; i < 8; i++) {
+        // the short frame misses 3..7, slot 3 is bad three times
+        uint16_t dropped = i < 3 ? 0 : i == 3 ? 4 : 1;
+
+        capture_stats(i, &stats, 0);
+        CHECK(stats.n == 1 && stats.min == US_TO_TICKS(good[i]) &&
+              stats.max == US_TO_TICKS(good[i]) && hist_sum(&stats) == 0,
+              "channel %d: n %u min %u max %u, %u changes", i, stats.n, stats.min,
+              stats.max, hist_sum(&stats));
+        CHECK(stats.dropped == dropped, "channel %d: %u dropped, expected %u",
+              i, stats.dropped, dropped);
+    }
+    frame(good, 8, 4000);
+    for (int i = 0; i < 8; i++) {
+        uint16_t lo = good[i] < us[i] ? good[i] : us[i];
+        uint16_t hi = good[i] < us[i] ? us[i] : good[i];
+
+        capture_stats(i, &stats, 1);
+        CHECK(stats.n == 2 && stats.min == US_TO_TICKS(lo) && stats.max == US_TO_TICKS(hi) &&
+              hist_sum(&stats) == 1,
+              "channel %d: n %u min %u max %u, %u changes", i, stats.n, stats.min,
+              stats.max, hist_sum(&stats));
+    }
+
+    printf("frames: 200 good ones exact, 6 kinds of corrupt ones counted\n");
+}
+
+// frame k: every channel follows from k
+#define CH(k, i) (1000 + ((k) * 13 + (i) * 101) % 1001)
+
+static volatile unsigned long edges, frames;
+static volatile uint8_t edge_i;
+
+static void on_signal(int sig)
+{
+    unsigned long k = frames;
+    uint8_t i = edge_i;
+
+    if (i < 8) {
+        edge_after(CH(k, i));
+        edge_i = i + 1;
+    } else {
+        edge_after(4000);
+        edge_i = 0;
+        frames = k + 1;
+    }
+    edges++;
+}
+
+static void check_read(void)
+{
+    struct sigaction sa = { .sa_handler = on_signal };
+    struct itimerval every = { { 0, 20 }, { 0, 20 } }, off = { { 0, 0 }, { 0, 0 } };
+    unsigned long reads = 0, interrupted = 0, mixed = 0;
+    capture_frame_t f;
+    time_t end;
+
+    // a gap to start on
+    edge_after(4000);
+    sigaction(SIGALRM, &sa, 0);
+    setitimer(ITIMER_REAL, &every, 0);
+
+    end = time(0) + 2;
+    while (time(0) < end || interrupted < 1000) {
+        unsigned long before = edges;
+        unsigned long k;
+
+        capture_frame(&f);
+        reads++;
+        if (edges != before)
+            interrupted++;
+        if (frames < 2)
+            continue;
+
+        // the frame channel 0 belongs to, CH(k, 0) repeats every 1001
+        for (k = 0; k < 1001 && CH(k, 0) != TICKS_TO_US(f.ch[0]); k++)
+            ;
+        for (uint8_t i = 0; i < 8; i++)
+            if (f.n != 8 || TICKS_TO_US(f.ch[i]) != CH(k, i)) {
+                mixed++;
+                break;
+            }
+        if (time(0) > end + 10)
+            break;
+    }
+
+    setitimer(ITIMER_REAL, &off, 0);
+
+    CHECK(mixed == 0, "%lu of %lu reads mix two frames", mixed, reads);
+    CHECK(interrupted >= 1000, "only %lu reads interrupted by an edge", interrupted);
+    printf("capture_frame: %lu reads, %lu interrupted by an edge, %lu frames, %lu mixed\n",
+           reads, interrupted, frames, mixed);
+}
+
+int main(void)
+{
+    check_frames();
+    check_read();
+
+    printf("%u checks, %u failed\n", checks, failed);
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,191 @@
+//
+// filtertest - host checks for the filter stages of examples/lib/filter.h
+//
+// usage: filtertest
+//
+// Runs each stage against a plain reference or hand picked inputs:
+// median3 against sorting on random triples and a spike, the EMA step
+// response and its range, the deadband in the middle and at both ends
+// of the range, and hold across the wrap of a 16 bit clock. Prints the
+// failed checks and exits non-zero if there are any.
+//
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "filter.h"
+
+static unsigned checks, failed;
+
+#define CHECK(cond, ...)                                \
+    do {                                                \
+        checks++;                                       \
+        if (!(cond)) {                                  \
+            failed++;                                   \
+            printf("%s:%d: ", __FILE__, __LINE__);      \
+            printf(__VA_ARGS__);                        \
+            printf("\n");                               \
+        }                                               \
+    } while (0)
+
+static uint16_t median_of(uint16_t a, uint16_t b, uint16_t c)
+{
+    uint16_t v[3] = { a, b, c };
+
+    for (int i = 0; i < 2; i++)
+        for (int j = 0; j < 2 - i; j++)
+            if (v[j] > v[j + 1]) {
+                uint16_t t = v[j];
+                v[j] = v[j + 1];
+                v[j + 1] = t;
+            }
+    return v[1];
+}
+
+static void test_median3(void)
+{
+    filter_median3_t f;
+    uint16_t x[3] = { 0, 0, 0 };
+
+    memset(&f, 0, sizeof(f));
+    for (int n = 0; n < 100000; n++) {
+        // few distinct values so that ties are common
+        uint16_t v = n % 7 ? rand() & 0x0f : rand();
+        uint16_t y = filter_median3(&f, v);
+
+        x[n % 3] = v;
+        CHECK(y == median_of(x[0], x[1], x[2]),
+              "median3 of %u %u %u gave %u", x[0], x[1], x[2], y);
+    }
+
+    // a single spike never gets through
+    memset(&f, 0, sizeof(f));
+    filter_median3(&f, 100);
+    filter_median3(&f, 100);
+    CHECK(filter_median3(&f, 1023) == 100, "median3 let a spike up through");
+    CHECK(filter_median3(&f, 100) == 100, "median3 kept the spike");
+    CHECK(filter_median3(&f, 0) == 100, "median3 let a spike down through");
+}
+
+static void test_ema(void)
+{
+    for (uint8_t shift = 1; shift <= 8; shift++) {
+        filter_ema_t f = { 0 };
+        uint16_t y = 0;
+        int n;
+
+        // a step settles exactly, up and down
+        for (n = 0; n < (64 << shift) && y != 1023; n++)
+            y = filter_ema(&f, 1023, shift);
+        CHECK(y == 1023, "ema shift %u settled at %u, not 1023", shift, y);
+        for (n = 0; n < (64 << shift) && y != 0; n++)
+            y = filter_ema(&f, 0, shift);
+        CHECK(y == 0, "ema shift %u settled at %u, not 0", shift, y);
+
+        // alpha 1 / 2^shift: the first step from 0 is x / 2^shift
+        memset(&f, 0, sizeof(f));
+        y = filter_ema(&f, 4096, shift);
+        CHECK(y == 4096 >> shift, "ema shift %u first step %u", shift, y);
+
+        // never leaves the range of the input, also at full 16 bit scale
+        memset(&f, 0, sizeof(f));
+        for (n = 0; n < 20000; n++) {
+            uint16_t x = rand() & 1 ? 0xffff : 0xff00 + (rand() & 0xff);
+            y = filter_ema(&f, x, shift);
+            if (n > (32 << shift))
+                CHECK(y >= 0xff00, "ema shift %u fell to %u", shift, y);
+        }
+    }
+
+    filter_ema_t f = { 0 };
+    uint16_t y = 0;
+    for (int n = 0; n < 2000000 && y != 0xffff; n++)
+        y = filter_ema(&f, 0xffff, 16);
+    CHECK(y == 0xffff, "ema shift 16 settled at %u", y);
+}
+
+static void test_deadband(void)
+{
+    const uint16_t band = 3, max = 1023;
+    filter_deadband_t f = { 500 };
+
+    // the middle, changes up to band are ignored
+    CHECK(filter_deadband(&f, 503, band, max) == 500, "deadband +band moved");
+    CHECK(filter_deadband(&f, 497, band, max) == 500, "deadband -band moved");
+    CHECK(filter_deadband(&f, 504, band, max) == 504, "deadband +band+1 held");
+    CHECK(filter_deadband(&f, 500, band, max) == 500, "deadband -band-1 held");
+
+    // the bottom end, every step down to 0 is followed
+    f.y = 5;
+    CHECK(filter_deadband(&f, 4, band, max) == 5, "deadband moved at 4");
+    CHECK(filter_deadband(&f, 3, band, max) == 3, "deadband held at 3");
+    CHECK(filter_deadband(&f, 1, band, max) == 1, "deadband held at 1");
+    CHECK(filter_deadband(&f, 0, band, max) == 0, "deadband did not reach 0");
+    CHECK(filter_deadband(&f, 2, band, max) == 2, "deadband held at 2 from 0");
+
+    // the top end, max is reached from within band
+    f.y = 1018;
+    CHECK(filter_deadband(&f, 1019, band, max) == 1018, "deadband moved at 1019");
+    CHECK(filter_deadband(&f, 1020, band, max) == 1020, "deadband held at 1020");
+    CHECK(filter_deadband(&f, 1023, band, max) == 1023, "deadband did not reach max");
+    CHECK(filter_deadband(&f, 1021, band, max) == 1021, "deadband held at 1021");
+
+    // noise of +-band around a value does not move it
+    f.y = 700;
+    for (int n = 0; n < 10000; n++) {
+        uint16_t x = 700 + rand() % (2 * band + 1) - band;
+        CHECK(filter_deadband(&f, x, band, max) == 700, "deadband moved on noise %u", x);
+    }
+
+    // the whole 16 bit range against the rule in 32 bits, the host int
+    // does not wrap like the 16 bit int of avr-gcc, so this pins the rule
+    // near 0 and 0xffff
+    for (int n = 0; n < 100000; n++) {
+        uint16_t y = n % 2 ? rand() : 0xffff - rand() % 64;
+        uint16_t x = n % 3 ? 0xffff - rand() % 64 : rand() % 64;
+        uint16_t b = n % 5 ? rand() % 64 : 0xffff - rand() % 64;
+        uint16_t m = n % 7 ? 0xffff - rand() % 64 : rand() % 64;
+        int32_t lx = x, ly = y, lb = b, lm = m;
+        uint16_t want = lx > ly + lb || lx + lb < ly || lx <= lb || lx >= lm - lb ? x : y;
+
+        f.y = y;
+        CHECK(filter_deadband(&f, x, b, m) == want,
+              "deadband y %u x %u band %u max %u", y, x, b, m);
+    }
+}
+
+static void test_hold(void)
+{
+    filter_hold_t f = { 100, 65500 };
+
+    // across the wrap of the clock
+    CHECK(filter_hold(&f, 200, 65520, 50) == 100, "hold let a change through early");
+    CHECK(filter_hold(&f, 200, 13, 50) == 100, "hold let a change through at 49");
+    CHECK(filter_hold(&f, 200, 14, 50) == 200, "hold kept a change at 50");
+    CHECK(f.t == 14, "hold did not restart the period, t %u", f.t);
+
+    // the period runs from the last change, not from the last call
+    CHECK(filter_hold(&f, 300, 40, 50) == 200, "hold let a second change through");
+    CHECK(filter_hold(&f, 300, 64, 50) == 300, "hold kept the second change");
+
+    // no change, no restart of the period
+    CHECK(filter_hold(&f, 300, 200, 50) == 300, "hold changed without a change");
+    CHECK(f.t == 64, "hold restarted the period without a change");
+    CHECK(filter_hold(&f, 301, 201, 50) == 301, "hold kept a change after a quiet period");
+}
+
+int main(void)
+{
+    srand(1);
+
+    test_median3();
+    test_ema();
+    test_deadband();
+    test_hold();
+
+    printf("filtertest: %u checks, %u failed\n", checks, failed);
+
+    return failed != 0;
+}
@@ -0,0 +1,13 @@
+#ifndef SIM_AVR_INTERRUPT_H
+#define SIM_AVR_INTERRUPT_H
+
+#include <avr/io.h>
+
+// interrupt routines are plain functions, idlesim.c calls them
+#define ISR(vector, ...) void vector(void); void vector(void)
+#define EMPTY_INTERRUPT(vector) void vector(void) {}
+
+void cli(void);
+void sei(void);
+
+#endif
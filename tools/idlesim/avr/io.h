@@ -0,0 +1,47 @@
+//
+// Registers of the ATmega328P used by idle.c, timer0.c and timerwheel.c,
+// backed by the simulation in idlesim.c. The interrupt flag registers
+// are write-one-to-clear; every access goes through sim_flags(), which
+// applies the writes seen since the last access. Reading a counter takes
+// a simulated cycle.
+//
+
+#ifndef SIM_AVR_IO_H
+#define SIM_AVR_IO_H
+
+#include <stdint.h>
+
+#define _BV(bit) (1 << (bit))
+
+extern volatile uint8_t sim_SREG, sim_TCCR0A, sim_TCCR0B, sim_TCNT0, sim_TIMSK0;
+extern volatile uint8_t sim_TCCR1A, sim_TCCR1B, sim_TIMSK1;
+extern volatile uint16_t sim_TCNT1, sim_OCR1A;
+
+volatile uint8_t *sim_flags(uint8_t reg);
+volatile uint8_t *sim_tcnt0(void);
+volatile uint16_t *sim_tcnt1(void);
+
+#define SREG sim_SREG
+#define TCCR0A sim_TCCR0A
+#define TCCR0B sim_TCCR0B
+#define TCNT0 (*sim_tcnt0())
+#define TIMSK0 sim_TIMSK0
+#define TIFR0 (*sim_flags(0))
+#define TCCR1A sim_TCCR1A
+#define TCCR1B sim_TCCR1B
+#define TCNT1 (*sim_tcnt1())
+#define OCR1A sim_OCR1A
+#define TIMSK1 sim_TIMSK1
+#define TIFR1 (*sim_flags(1))
+
+#define CS00 0
+#define CS01 1
+#define CS02 2
+#define TOIE0 0
+#define TOV0 0
+#define CS10 0
+#define CS11 1
+#define OCIE1A 1
+#define OCF1A 1
+
+#endif
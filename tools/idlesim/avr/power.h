@@ -0,0 +1,7 @@
+#ifndef SIM_AVR_POWER_H
+#define SIM_AVR_POWER_H
+
+#define power_twi_disable()
+#define power_spi_disable()
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef SIM_AVR_SLEEP_H
+#define SIM_AVR_SLEEP_H
+
+#define SLEEP_MODE_IDLE 0
+
+#define set_sleep_mode(mode) ((void)(mode))
+#define sleep_enable()
+#define sleep_disable()
+
+// runs the simulation up to the next enabled interrupt
+void sleep_cpu(void);
+
+#endif
@@ -0,0 +1,320 @@
+//
+// idlesim - time asleep and wake-ups of examples/lib/idle.c
+//
+// usage: idlesim
+//
+// Runs idle.c, timer0.c and timerwheel.c unchanged on the host against a
+// cycle level model of the ATmega328P at 16 MHz: timer0 at /64 with its
+// overflow interrupt, timer1 at /8 with the OCR1A compare, sleep_cpu()
+// until the next enabled interrupt. The main loop of the examples,
+// timerwheel_run() then idle(), runs for 10 simulated seconds in three
+// load cases and prints the share of time asleep, what idle_permille()
+// made of it, the wake-ups per second and how late the timer callbacks
+// ran after their tick. Built twice, idlesim with plain idle() and
+// idlesim-tickless with -DIDLE_TICKLESS.
+//
+// The firmware's own cycles are not simulated, they are charged as the
+// estimates below. After every idle() micros() and millis() are checked
+// against the simulated time; the program fails on any difference, or
+// if a callback runs early or more than 500 us late.
+//
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <avr/interrupt.h>
+
+#include "idle.h"
+#include "timer0.h"
+#include "timerwheel.h"
+
+// estimated cycles, interrupt entry and exit included
+#define LOOP_CYCLES 150         // timerwheel_run() and idle() without callbacks
+#define CONTROL_CYCLES 3000     // a 10 ms control step
+#define REPORT_CYCLES 1500      // a telemetry report every second
+#define OVF_CYCLES 80           // TIMER0_OVF_vect
+#define COMPA_CYCLES 10         // TIMER1_COMPA_vect, EMPTY_INTERRUPT
+#define EXT_CYCLES 60           // some other interrupt, a capture edge say
+
+#define RUN_CYCLES (10 * F_CPU)
+#define MAX_LATE_CYCLES (500 * (F_CPU / 1000000))
+
+volatile uint8_t sim_SREG, sim_TCCR0A, sim_TCCR0B, sim_TCNT0, sim_TIMSK0;
+volatile uint8_t sim_TCCR1A, sim_TCCR1B, sim_TIMSK1;
+volatile uint16_t sim_TCNT1, sim_OCR1A;
+
+void TIMER0_OVF_vect(void);
+#ifdef IDLE_TICKLESS
+void TIMER1_COMPA_vect(void);
+#else
+#define TIMER1_COMPA_vect()
+#endif
+
+static uint64_t now;            // cpu cycles since reset
+static uint8_t flags[2];        // TIFR0, TIFR1
+static volatile uint8_t shown[2];
+static uint8_t interrupts;      // the I bit
+
+static uint64_t ext_period;     // cycles between other interrupts, 0 for none
+static uint64_t ext_next;
+static uint8_t ext_flag;
+
+static uint64_t asleep;
+static unsigned long wakeups;
+static uint64_t max_late;
+static unsigned permille_sum, permille_n;
+
+static void run(uint64_t cycles, int until_wake);
+
+// bit 7 is not used in TIFR0 and TIFR1; a value without it was written
+#define SHOWN 0x80
+
+static void sync_flags(uint8_t reg)
+{
+    if (!(shown[reg] & SHOWN))
+        flags[reg] &= ~shown[reg];
+    shown[reg] = flags[reg] | SHOWN;
+}
+
+volatile uint8_t *sim_flags(uint8_t reg)
+{
+    sync_flags(reg);
+    return &shown[reg];
+}
+
+void cli(void)
+{
+    interrupts = 0;
+}
+
+void sei(void)
+{
+    interrupts = 1;
+}
+
+static void set_counters(void)
+{
+    sim_TCNT0 = now / 64;
+    sim_TCNT1 = now / 8;
+}
+
+static uint64_t next_event(void)
+{
+    uint64_t ovf = (now / 16384 + 1) * 16384;
+    uint16_t d = sim_OCR1A - (uint16_t)(now / 8);
+    uint64_t cmp = (now / 8 + (d ? d : 65536)) * 8;
+    uint64_t t = ovf < cmp ? ovf : cmp;
+
+    if (ext_period && ext_next < t)
+        t = ext_next;
+    return t;
+}
+
+// Service the pending and enabled interrupts in vector order, returns
+// the number serviced.
+static unsigned service(void)
+{
+    unsigned n = 0;
+
+    sync_flags(0);
+    sync_flags(1);
+    while (interrupts) {
+        interrupts = 0;
+        if (ext_flag) {
+            ext_flag = 0;
+            run(EXT_CYCLES, 0);
+        } else if ((flags[1] & _BV(OCF1A)) && (sim_TIMSK1 & _BV(OCIE1A))) {
+            flags[1] &= ~_BV(OCF1A);
+            TIMER1_COMPA_vect();
+            run(COMPA_CYCLES, 0);
+        } else if ((flags[0] & _BV(TOV0)) && (sim_TIMSK0 & _BV(TOIE0))) {
+            flags[0] &= ~_BV(TOV0);
+            TIMER0_OVF_vect();
+            run(OVF_CYCLES, 0);
+        } else {
+            interrupts = 1;
+            break;
+        }
+        interrupts = 1;
+        n++;
+    }
+    shown[0] = flags[0] | SHOWN;
+    shown[1] = flags[1] | SHOWN;
+
+    return n;
+}
+
+// Run for the given number of cycles, or with until_wake up to the
+// first interrupt serviced. Interrupts are serviced as they come when
+// enabled, otherwise only their flags are set.
+static void run(uint64_t cycles, int until_wake)
+{
+    uint64_t end = now + cycles;
+
+    for (;;) {
+        uint64_t t = next_event();
+
+        // an interrupt routine may have run past the other interrupt
+        if (t < now)
+            t = now;
+
+        sync_flags(0);
+        sync_flags(1);
+        if (!until_wake && t > end) {
+            now = end;
+            set_counters();
+            return;
+        }
+
+        if (until_wake)
+            asleep += t - now;
+        now = t;
+        set_counters();
+
+        if (now % 16384 == 0)
+            flags[0] |= _BV(TOV0);
+        if ((uint16_t)(now / 8) == sim_OCR1A && now % 8 == 0)
+            flags[1] |= _BV(OCF1A);
+        if (ext_period && now >= ext_next) {
+            ext_flag = 1;
+            ext_next += ext_period;
+        }
+        shown[0] = flags[0] | SHOWN;
+        shown[1] = flags[1] | SHOWN;
+
+        if (service() > 0 && until_wake)
+            return;
+    }
+}
+
+void sleep_cpu(void)
+{
+    wakeups++;
+    run(0, 1);
+}
+
+// a counter reading takes a cycle, so busy waits on TCNT0 end
+volatile uint8_t *sim_tcnt0(void)
+{
+    run(1, 0);
+    return &sim_TCNT0;
+}
+
+volatile uint16_t *sim_tcnt1(void)
+{
+    run(1, 0);
+    return &sim_TCNT1;
+}
+
+static uint64_t base;            // tick of timerwheel_init()
+static uint16_t control_delay, control_period;
+static unsigned long control_runs;
+
+static void late(uint16_t tick)
+{
+    uint64_t due = (base + tick) * 16384;
+
+    if (now < due) {
+        printf("callback %llu cycles early\n", (unsigned long long)(due - now));
+        exit(1);
+    }
+    if (now - due > MAX_LATE_CYCLES) {
+        printf("callback %llu cycles late\n", (unsigned long long)(now - due));
+        exit(1);
+    }
+    if (now - due > max_late)
+        max_late = now - due;
+}
+
+static void control(void)
+{
+    late(control_delay + control_runs * control_period);
+    control_runs++;
+    run(CONTROL_CYCLES, 0);
+}
+
+static unsigned long report_runs;
+
+static void report(void)
+{
+    late(TIMER0_MS_TO_TICKS(1000) * (report_runs + 1));
+    report_runs++;
+    permille_sum += idle_permille();
+    permille_n++;
+    run(REPORT_CYCLES, 0);
+}
+
+static void check_clock(void)
+{
+    unsigned long us, ms;
+
+    cli();
+    us = micros();
+    if (us != (unsigned long)(now / 64 * 4)) {
+        printf("micros() %lu, simulated %lu\n", us, (unsigned long)(now / 64 * 4));
+        exit(1);
+    }
+    // millis() counts 1.024 ms ticks in steps of 1 or 2 ms
+    ms = millis();
+    if (ms > us / 1000 || us / 1000 - ms > 2) {
+        printf("millis() %lu, simulated %lu\n", ms, us / 1000);
+        exit(1);
+    }
+    sei();
+}
+
+static void simulate(const char *name, unsigned ext_hz)
+{
+    uint64_t start;
+
+    // the clock runs on from the case before
+    asleep = 0;
+    wakeups = 0;
+    max_late = 0;
+    ext_period = ext_hz ? F_CPU / ext_hz : 0;
+    ext_next = now + ext_period / 3;
+    ext_flag = 0;
+    control_runs = report_runs = 0;
+    permille_sum = permille_n = 0;
+
+    setup_idle();
+
+    control_delay = control_period = TIMER0_MS_TO_TICKS(10);
+    base = now / 16384;
+    timerwheel_init();
+    timerwheel_start(control_delay, control_period, control);
+    timerwheel_start(TIMER0_MS_TO_TICKS(1000), TIMER0_MS_TO_TICKS(1000), report);
+
+    start = now;
+    while (now - start < RUN_CYCLES) {
+        timerwheel_run();
+        run(LOOP_CYCLES, 0);
+        idle();
+        check_clock();
+    }
+
+    printf("%-22s %5.1f %%   %4u   %6.0f   %5.1f us   %lu\n", name,
+           100.0 * asleep / (now - start),
+           permille_n ? permille_sum / permille_n : 0,
+           wakeups * (double)F_CPU / (now - start),
+           max_late * 1e6 / F_CPU, control_runs);
+}
+
+int main(void)
+{
+#ifdef IDLE_TICKLESS
+    printf("tickless idle()\n");
+#else
+    printf("plain idle()\n");
+#endif
+    setup_timer0();
+    sim_TCCR1B = _BV(CS11);     // setup_ticks()
+
+    printf("load                   asleep  permille wakeups/s  late max    control runs\n");
+    simulate("timers only", 0);
+    simulate("+ 100 Hz interrupt", 100);
+    simulate("+ 2 kHz interrupt", 2000);
+
+    return 0;
+}
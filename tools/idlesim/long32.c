@@ -0,0 +1,13 @@
+//
+// long32.c - the timer0.h constants with the 32 bit long of avr-gcc
+//
+// "make check" compiles this with -m32 for each F_CPU of the examples.
+// The host long has 64 bits and hides an overflow, here it shows as a
+// -Woverflow error or a negative array size.
+//
+
+#include "timer0.h"
+
+typedef char tick_us[TIMER0_TICK_US == 64LL * 256 * 1000000 / F_CPU ? 1 : -1];
+typedef char ms_10[TIMER0_MS_TO_TICKS(10) == 10LL * 1000 / TIMER0_TICK_US ? 1 : -1];
+typedef char ms_3000[TIMER0_MS_TO_TICKS(3000) == 3000LL * 1000 / TIMER0_TICK_US ? 1 : -1];
@@ -0,0 +1,234 @@
+//
+// pidsim - examples/lib/pid.c against a simulated DC motor
+//
+// usage: pidsim
+//
+// Runs pid_step() at 100 Hz with the gains, output range and offset of
+// examples/motorcontrol on a model of the motor they were tuned for:
+// 6000 rpm at full pwm, a first order lag of 150 ms, nothing below the
+// pwm where it starts to turn, a load that takes rpm off. The tachometer
+// reading is quantised to 1 rpm with +-0.5 % noise. Checks, each from
+// standstill or steady state:
+//
+//   step        0 -> 3000 rpm: overshoot below 5 %, within 1 % after 1 s
+//   kff         feed-forward a quarter above the need: the integral
+//               goes negative and the error still settles within 1 %
+//   load        a 1200 rpm load step: back within 1 % after 1 s
+//   windup      2 s saturated at an unreachable 7000 rpm, then 3000:
+//               within 1 % after 1.5 s, undershoot below 5 %
+//
+// and for random gains up to PID_GAIN_MAX and inputs over the whole 16
+// bit range that the output stays within out_min..out_max and the
+// integral within +-(out_max - out_min) * PID_ONE. Prints the failed
+// checks and exits non-zero if there are any.
+//
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pid.h"
+
+static unsigned checks, failed;
+
+#define CHECK(cond, ...)                                \
+    do {                                                \
+        checks++;                                       \
+        if (!(cond)) {                                  \
+            failed++;                                   \
+            printf("%s:%d: ", __FILE__, __LINE__);      \
+            printf(__VA_ARGS__);                        \
+            printf("\n");                               \
+        }                                               \
+    } while (0)
+
+// as in examples/motorcontrol
+#define LOOP_HZ 100
+#define PWM_MIN 0x40
+#define PWM_MAX 0xff
+#define RPM_MAX 6000
+#define PID_KP 28
+#define PID_KI 1
+#define PID_KD 0
+#define PID_KFF 8
+
+#define TAU 0.15
+#define SUBSTEPS 10
+
+static double rpm, load;
+
+static uint32_t state = 1;
+
+static uint32_t xorshift(void)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+// one loop period of the motor at pwm
+static void motor(int pwm)
+{
+    double drive = pwm > PWM_MIN ? (pwm - PWM_MIN) * (double)RPM_MAX / (PWM_MAX - PWM_MIN) : 0;
+    double target = drive - load;
+
+    if (target < 0)
+        target = 0;
+    for (int i = 0; i < SUBSTEPS; i++)
+        rpm += (target - rpm) / (TAU * LOOP_HZ * SUBSTEPS);
+}
+
+static int16_t tacho(void)
+{
+    double noise = ((int)(xorshift() % 1001) - 500) / 100000.0;
+
+    return (int16_t)lround(rpm * (1 + noise));
+}
+
+static pid_ctrl_t pid;
+
+static void setup(void)
+{
+    pid_init(&pid, 0, PWM_MAX);
+    pid.kp = PID_KP;
+    pid.ki = PID_KI;
+    pid.kd = PID_KD;
+    pid.kff = PID_KFF;
+    pid.offset = PWM_MIN;
+    rpm = 0;
+    load = 0;
+    pid_reset(&pid, 0);
+}
+
+typedef struct {
+    double max, min;        // rpm over the run
+    double settled;         // largest error after the settle time
+    int saturated;          // steps at out_max
+} run_t;
+
+// Runs seconds at sp, the error counts from settle seconds on.
+static run_t run(int16_t sp, double seconds, double settle)
+{
+    run_t r = { rpm, rpm, 0, 0 };
+    int steps = seconds * LOOP_HZ;
+
+    for (int k = 0; k < steps; k++) {
+        int16_t out = pid_step(&pid, sp, tacho());
+
+        if (out == PWM_MAX)
+            r.saturated++;
+        motor(out);
+        if (rpm > r.max)
+            r.max = rpm;
+        if (rpm < r.min)
+            r.min = rpm;
+        if (k >= settle * LOOP_HZ && fabs(rpm - sp) > r.settled)
+            r.settled = fabs(rpm - sp);
+    }
+    return r;
+}
+
+static void check_control(void)
+{
+    run_t r;
+
+    setup();
+    r = run(3000, 3, 1);
+    CHECK(r.max < 3000 * 1.05, "step: overshoot to %.0f rpm", r.max);
+    CHECK(r.settled < 30, "step: %.0f rpm off after 1 s", r.settled);
+    printf("step 0 -> 3000       overshoot %4.0f rpm, error after 1 s %3.0f rpm\n",
+           r.max - 3000, r.settled);
+
+    // feed-forward a quarter above what the motor needs, the integral
+    // has to take it back
+    pid.kff = PID_KFF * 5 / 4;
+    run(3000, 2, 0);
+    r = run(3000, 1, 0);
+    CHECK(pid.i < 0, "high feed-forward: integral %ld", (long)pid.i);
+    CHECK(r.settled < 30, "high feed-forward: %.0f rpm off", r.settled);
+    printf("kff %d               integral %4ld pwm, error %3.0f rpm\n",
+           pid.kff, (long)(pid.i / PID_ONE), r.settled);
+    pid.kff = PID_KFF;
+    run(3000, 2, 0);
+
+    load = 1200;
+    r = run(3000, 3, 1);
+    CHECK(r.settled < 30, "load: %.0f rpm off after 1 s", r.settled);
+    CHECK(pid.i > 0, "load: integral %ld", (long)pid.i);
+    printf("load step 1200 rpm   dip %4.0f rpm, error after 1 s %3.0f rpm\n",
+           3000 - r.min, r.settled);
+
+    load = 0;
+    r = run(7000, 2, 0);
+    CHECK(r.saturated > 100, "windup: only %d steps saturated", r.saturated);
+    r = run(3000, 3, 1.5);
+    CHECK(r.min > 3000 * 0.95, "windup: undershoot to %.0f rpm", r.min);
+    CHECK(r.settled < 30, "windup: %.0f rpm off after 1.5 s", r.settled);
+    printf("7000 saturated, 3000 undershoot %4.0f rpm, error after 1.5 s %3.0f rpm\n",
+           r.min < 3000 ? 3000 - r.min : 0, r.settled);
+}
+
+static int16_t random16(void)
+{
+    return (int16_t)(xorshift() & 0xffff);
+}
+
+static void check_range(void)
+{
+    unsigned long bad_out = 0, bad_i = 0, bad_sum = 0;
+
+    for (int n = 0; n < 2000; n++) {
+        int16_t lo = random16() >> (xorshift() % 16);
+        int16_t hi = lo + (int16_t)(xorshift() % (INT16_MAX - (lo > 0 ? lo : 0)));
+        int32_t limit = ((int32_t)hi - lo) * PID_ONE;
+
+        pid_init(&pid, lo, hi);
+        pid.kp = xorshift() % (PID_GAIN_MAX + 1);
+        pid.ki = xorshift() % (PID_GAIN_MAX + 1);
+        pid.kd = xorshift() % (PID_GAIN_MAX + 1);
+        pid.kff = xorshift() % (PID_GAIN_MAX + 1);
+        pid.offset = xorshift() % 256;
+        pid.d_shift = xorshift() % 5;
+
+        for (int k = 0; k < 1000; k++) {
+            int16_t sp = k % 100 < 50 ? random16() : random16() >> 8;
+            int16_t pv = random16();
+            int16_t out = pid_step(&pid, sp, pv);
+            int32_t e = (int32_t)sp - pv;
+            int32_t u;
+
+            if (out < lo || out > hi)
+                bad_out++;
+            if (pid.i > limit || pid.i < -limit)
+                bad_i++;
+
+            // the output is the sum of the terms after the step, a clamped
+            // integral must not move it by the part that was cut off
+            e = e > INT16_MAX ? INT16_MAX : e < -INT16_MAX ? -INT16_MAX : e;
+            u = pid.kp * e + pid.i + pid.d + (int32_t)pid.kff * sp;
+            if (sp > 0)
+                u += (int32_t)pid.offset * PID_ONE;
+            else if (sp < 0)
+                u -= (int32_t)pid.offset * PID_ONE;
+            u = u > (int32_t)hi * PID_ONE ? (int32_t)hi * PID_ONE : u;
+            u = u < (int32_t)lo * PID_ONE ? (int32_t)lo * PID_ONE : u;
+            if (out != (u + PID_ONE / 2) >> 8)
+                bad_sum++;
+        }
+    }
+    CHECK(bad_out == 0, "%lu outputs out of range", bad_out);
+    CHECK(bad_i == 0, "%lu integrals beyond the clamp", bad_i);
+    CHECK(bad_sum == 0, "%lu outputs not the sum of the terms", bad_sum);
+}
+
+int main(void)
+{
+    check_control();
+    check_range();
+
+    printf("%u checks, %u failed\n", checks, failed);
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,145 @@
+//
+// pintest - host checks for the pin tuples of examples/lib/pin.h
+//
+// usage: pintest
+//
+// Expands every macro against the registers of tools/avrstub and checks
+// that it touches only its own bits of the right register: the data
+// direction from PIN_INIT and PINS_INIT, PORTx for set, clear, pull-up
+// and group writes, a single PINx store for toggle, PINx for reads. The
+// pin on port B uses bit 0, the group on port D bits 2 and 5, so a bit
+// number taken for a mask or the other way round shows up.
+//
+// Built with -DMISUSE=n, n = 1..5, it must not compile: each case uses a
+// macro against the direction of its pin and "make check" expects the
+// error to name the matching pin_error_... identifier.
+//
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "pin.h"
+
+#define LED         (OUT, B, 0)
+#define BUTTON      (IN, D, 7)
+#define SWITCHES    (IN, C, _BV(1) | _BV(3))
+#define MOTOR_DIR   (OUT, D, _BV(2) | _BV(5))
+
+static unsigned checks, failed;
+
+#define CHECK(cond, ...)                                \
+    do {                                                \
+        checks++;                                       \
+        if (!(cond)) {                                  \
+            failed++;                                   \
+            printf("%s:%d: ", __FILE__, __LINE__);      \
+            printf(__VA_ARGS__);                        \
+            printf("\n");                               \
+        }                                               \
+    } while (0)
+
+#if MISUSE
+void misuse(void)
+{
+#if MISUSE == 1
+    PIN_SET(BUTTON);
+#elif MISUSE == 2
+    PIN_CLEAR(BUTTON);
+#elif MISUSE == 3
+    PIN_TOGGLE(BUTTON);
+#elif MISUSE == 4
+    PIN_PULLUP(LED);
+#elif MISUSE == 5
+    PINS_WRITE(SWITCHES, 0);
+#endif
+}
+#endif
+
+static void reset(uint8_t v)
+{
+    DDRB = DDRC = DDRD = v;
+    PORTB = PORTC = PORTD = v;
+    PINB = PINC = PIND = v;
+}
+
+// only the expected register changed, to the expected value
+#define CHANGED(reg, from, to) \
+    (reg == (to) && DDRB + DDRC + DDRD + PORTB + PORTC + PORTD + PINB + PINC + PIND \
+     - reg == 8 * (from))
+
+static void check_single(void)
+{
+    for (int v = 0; v < 256; v += 255) {
+        reset(v);
+        PIN_INIT(LED);
+        CHECK(CHANGED(DDRB, v, v | 0x01), "PIN_INIT out from %02x: DDRB %02x", v, DDRB);
+
+        reset(v);
+        PIN_INIT(BUTTON);
+        CHECK(CHANGED(DDRD, v, v & ~0x80), "PIN_INIT in from %02x: DDRD %02x", v, DDRD);
+
+        reset(v);
+        PIN_SET(LED);
+        CHECK(CHANGED(PORTB, v, v | 0x01), "PIN_SET from %02x: PORTB %02x", v, PORTB);
+
+        reset(v);
+        PIN_CLEAR(LED);
+        CHECK(CHANGED(PORTB, v, v & ~0x01), "PIN_CLEAR from %02x: PORTB %02x", v, PORTB);
+
+        // writing a one to PINx toggles, a read-modify-write would not do
+        reset(v);
+        PIN_TOGGLE(LED);
+        CHECK(CHANGED(PINB, v, 0x01), "PIN_TOGGLE from %02x: PINB %02x", v, PINB);
+
+        reset(v);
+        PIN_PULLUP(BUTTON);
+        CHECK(CHANGED(PORTD, v, v | 0x80), "PIN_PULLUP from %02x: PORTD %02x", v, PORTD);
+    }
+
+    reset(0);
+    PIND = 0x80;
+    CHECK(PIN_READ(BUTTON), "PIN_READ with PIND %02x", PIND);
+    PIND = 0x7f;
+    CHECK(!PIN_READ(BUTTON), "PIN_READ with PIND %02x", PIND);
+    PINB = 0x01;
+    CHECK(PIN_READ(LED), "PIN_READ with PINB %02x", PINB);
+}
+
+static void check_group(void)
+{
+    for (int v = 0; v < 256; v += 255) {
+        reset(v);
+        PINS_INIT(MOTOR_DIR);
+        CHECK(CHANGED(DDRD, v, v | 0x24), "PINS_INIT out from %02x: DDRD %02x", v, DDRD);
+
+        reset(v);
+        PINS_INIT(SWITCHES);
+        CHECK(CHANGED(DDRC, v, v & ~0x0a), "PINS_INIT in from %02x: DDRC %02x", v, DDRC);
+    }
+
+    // every port value and every written value, bits outside the mask
+    // keep theirs
+    for (int port = 0; port < 256; port++)
+        for (int w = 0; w < 256; w++) {
+            uint8_t expect = (port & ~0x24) | (w & 0x24);
+
+            reset(0);
+            PORTD = port;
+            PINS_WRITE(MOTOR_DIR, w);
+            if (PORTD != expect || DDRD || PIND || PORTB || PORTC) {
+                CHECK(0, "PINS_WRITE %02x on %02x: PORTD %02x", w, port, PORTD);
+                return;
+            }
+        }
+    checks++;
+}
+
+int main(void)
+{
+    check_single();
+    check_group();
+
+    printf("%u checks, %u failed\n", checks, failed);
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,112 @@
+#!/usr/bin/env python3
+#
+# serialbench - host half of examples/serialbench
+#
+# Measures round trip latency, sustained echo throughput and lost bytes
+# against the serialbench firmware. The baud rate is fixed at build time
+# on the target, so run once per flashed rate:
+#
+#   ./serialbench.py -b 1000000 /dev/ttyUSB0
+#
+# Requires pyserial.
+
+import argparse
+import re
+import sys
+import time
+
+import serial
+
+
+def drain(port):
+    port.reset_input_buffer()
+    time.sleep(0.05)
+    port.reset_input_buffer()
+
+
+def latency(port, rounds):
+    samples = []
+    for i in range(rounds):
+        b = bytes([0x41 + i % 26])
+        t0 = time.perf_counter()
+        port.write(b)
+        r = port.read(1)
+        t1 = time.perf_counter()
+        if r == b:
+            samples.append(t1 - t0)
+    return samples
+
+
+def throughput(port, total, chunk):
+    # payload without zero bytes, zero requests the counter report
+    pattern = bytes((i % 255) + 1 for i in range(chunk))
+    sent = received = lost = 0
+    t0 = t1 = time.perf_counter()
+
+    while True:
+        # keep a few chunks in flight, more only fills the host buffers
+        if sent < total and sent - received - lost < 4 * chunk:
+            port.write(pattern)
+            sent += len(pattern)
+        data = port.read(port.in_waiting or 1)
+        if data:
+            received += len(data)
+            t1 = time.perf_counter()
+        else:
+            # read timed out, whatever is still in flight was lost
+            lost = sent - received
+            if sent >= total:
+                break
+
+    return sent, received, t1 - t0
+
+
+def counters(port):
+    port.write(b"\0")
+    line = port.readline().decode("ascii", "replace")
+    m = re.match(r"R([0-9A-F]{4}) T([0-9A-F]{4})", line)
+    if not m:
+        return None
+    return int(m.group(1), 16), int(m.group(2), 16)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__)
+    ap.add_argument("-b", "--baud", type=int, default=1000000)
+    ap.add_argument("-n", "--bytes", type=int, default=200000)
+    ap.add_argument("-c", "--chunk", type=int, default=64)
+    ap.add_argument("-r", "--rounds", type=int, default=200)
+    ap.add_argument("device")
+    args = ap.parse_args()
+
+    port = serial.Serial(args.device, args.baud, timeout=0.5)
+    time.sleep(2)  # boards with auto reset restart on open
+    drain(port)
+
+    before = counters(port)
+    lat = latency(port, args.rounds)
+    sent, received, elapsed = throughput(port, args.bytes, args.chunk)
+    time.sleep(0.1)
+    after = counters(port)
+
+    wire = args.baud / 10.0  # 8N1, bytes per second
+    print("baud            %d (%.0f bytes/s on the wire)" % (args.baud, wire))
+    if lat:
+        lat.sort()
+        print("latency us      min %.0f median %.0f max %.0f (%d/%d)" % (
+            lat[0] * 1e6, lat[len(lat) // 2] * 1e6, lat[-1] * 1e6,
+            len(lat), args.rounds))
+    print("throughput      %.0f bytes/s echoed (%.1f%% of wire)" % (
+        received / elapsed, 100.0 * received / elapsed / wire))
+    print("lost            %d of %d bytes" % (sent - received, sent))
+    if before and after:
+        print("target rx/tx overflows  %d / %d" % (
+            (after[0] - before[0]) & 0xffff, (after[1] - before[1]) & 0xffff))
+    else:
+        print("target counters unavailable")
+
+    return 0 if sent == received else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,195 @@
+//
+// telemdump - decode the binary telemetry stream of examples/lib/telemetry.c
+//
+// usage: telemdump [-b baud] [device-or-file]
+//
+// Reads from a serial device, a captured file or stdin and prints one CSV
+// line per value: seq,timestamp,type,value. Frames with a bad CRC or bad
+// COBS encoding and gaps in the sequence numbers are counted and reported
+// on stderr when the input ends.
+//
+
+#define _DEFAULT_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "cobs.h"
+#include "crc16.h"
+#include "telemetry.h"
+
+#define MAX_ENCODED COBS_ENCODED_SIZE(255)
+
+typedef struct {
+    unsigned long frames;
+    unsigned long values;
+    unsigned long bad_cobs;
+    unsigned long bad_crc;
+    unsigned long bad_length;
+    unsigned long dropped;
+    unsigned long oversize;
+    int have_seq;
+    uint8_t last_seq;
+} stats_t;
+
+static speed_t tobaud(long baud)
+{
+    switch (baud) {
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+#ifdef B500000
+    case 500000: return B500000;
+#endif
+#ifdef B1000000
+    case 1000000: return B1000000;
+#endif
+    default: return 0;
+    }
+}
+
+static int setup_tty(int fd, long baud)
+{
+    struct termios tio;
+    speed_t speed = tobaud(baud);
+
+    if (speed == 0) {
+        fprintf(stderr, "telemdump: unsupported baud rate %ld\n", baud);
+        return -1;
+    }
+
+    if (tcgetattr(fd, &tio) < 0)
+        return -1;
+
+    cfmakeraw(&tio);
+    cfsetispeed(&tio, speed);
+    cfsetospeed(&tio, speed);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cc[VMIN] = 1;
+    tio.c_cc[VTIME] = 0;
+
+    return tcsetattr(fd, TCSANOW, &tio);
+}
+
+static void frame(stats_t *st, const uint8_t *enc, unsigned len)
+{
+    uint8_t buf[MAX_ENCODED];
+    unsigned n, i;
+    uint16_t crc, timestamp;
+    uint8_t seq;
+
+    n = cobs_decode(enc, len, buf);
+    if (n == 0) {
+        st->bad_cobs++;
+        return;
+    }
+
+    if (n < TELEMETRY_HEADER_SIZE + TELEMETRY_CRC_SIZE) {
+        st->bad_length++;
+        return;
+    }
+
+    crc = buf[n - 2] | (buf[n - 1] << 8);
+    n -= TELEMETRY_CRC_SIZE;
+    if (crc16(buf, n) != crc) {
+        st->bad_crc++;
+        return;
+    }
+
+    seq = buf[0];
+    timestamp = buf[1] | (buf[2] << 8);
+
+    if (st->have_seq)
+        st->dropped += (uint8_t)(seq - st->last_seq - 1);
+    st->have_seq = 1;
+    st->last_seq = seq;
+
+    for (i = TELEMETRY_HEADER_SIZE; i < n; ) {
+        unsigned type = buf[i] >> 4;
+        unsigned count = (buf[i] & 0x0f) + 1;
+
+        if (i + 1 + 2 * count > n) {
+            st->bad_length++;
+            return;
+        }
+
+        for (i++; count > 0; count--, i += 2) {
+            printf("%u,%u,%u,%u\n", seq, timestamp, type, buf[i] | (buf[i + 1] << 8));
+            st->values++;
+        }
+    }
+
+    st->frames++;
+}
+
+int main(int argc, char **argv)
+{
+    stats_t st;
+    uint8_t enc[MAX_ENCODED];
+    uint8_t chunk[256];
+    unsigned len = 0;
+    long baud = 57600;
+    int fd = 0, opt;
+    ssize_t n;
+
+    while ((opt = getopt(argc, argv, "b:")) != -1) {
+        switch (opt) {
+        case 'b':
+            baud = strtol(optarg, NULL, 10);
+            break;
+        default:
+            fprintf(stderr, "usage: telemdump [-b baud] [device-or-file]\n");
+            return 2;
+        }
+    }
+
+    if (optind < argc) {
+        fd = open(argv[optind], O_RDONLY | O_NOCTTY);
+        if (fd < 0) {
+            fprintf(stderr, "telemdump: %s: %s\n", argv[optind], strerror(errno));
+            return 1;
+        }
+        if (isatty(fd) && setup_tty(fd, baud) < 0) {
+            fprintf(stderr, "telemdump: %s: cannot configure tty\n", argv[optind]);
+            return 1;
+        }
+    }
+
+    memset(&st, 0, sizeof(st));
+    printf("seq,timestamp,type,value\n");
+
+    while ((n = read(fd, chunk, sizeof(chunk))) > 0) {
+        for (ssize_t i = 0; i < n; i++) {
+            uint8_t c = chunk[i];
+
+            if (c == 0) {
+                // a capture that starts mid-frame costs one bad frame
+                if (len > 0 && len <= sizeof(enc))
+                    frame(&st, enc, len);
+                len = 0;
+            } else if (len < sizeof(enc)) {
+                enc[len++] = c;
+            } else if (len == sizeof(enc)) {
+                st.oversize++;
+                len++;
+            }
+        }
+        fflush(stdout);
+    }
+
+    fprintf(stderr, "frames %lu values %lu dropped %lu bad-crc %lu bad-cobs %lu "
+            "bad-length %lu oversize %lu\n",
+            st.frames, st.values, st.dropped, st.bad_crc, st.bad_cobs,
+            st.bad_length, st.oversize);
+
+    return 0;
+}
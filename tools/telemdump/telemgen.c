@@ -0,0 +1,98 @@
+//
+// telemgen - write a known telemetry stream for the telemdump round trip
+//
+// usage: telemgen > stream.bin
+//
+// Runs examples/lib/telemetry.c on the host against a usart stand-in
+// that writes to stdout. The stream holds full and partly filled frames,
+// empty sends, which must not use up a sequence number, and one frame
+// dropped for lack of tx space, which must show up as a gap. Damaged
+// copies of a frame follow: one with a flipped bit and one cut short.
+// "make check" decodes it with telemdump and compares with roundtrip.csv.
+//
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "telemetry.h"
+#include "usart.h"
+
+static uint8_t tx_free = 255;
+static uint8_t last[256];
+static unsigned last_len;
+
+uint8_t usart_tx_free(void)
+{
+    return tx_free;
+}
+
+uint8_t usart_write(uint8_t c)
+{
+    putchar(c);
+    last[last_len++] = c;
+    return 1;
+}
+
+static void send(telemetry_t *t)
+{
+    last_len = 0;
+    telemetry_send(t);
+}
+
+int main(void)
+{
+    telemetry_t t;
+    uint16_t v = 0;
+    unsigned i;
+
+    telemetry_init(&t);
+
+    // not sent: telemetry_full() leaves room for a sample that opens a
+    // new block, two ADC samples first so the free space comes down to 2
+    telemetry_begin(&t, 0);
+    telemetry_add(&t, TELEMETRY_TYPE_ADC, 0);
+    for (i = 0; !telemetry_full(&t); i++) {
+        if (!telemetry_add(&t, i % 2 ? TELEMETRY_TYPE_PWM : TELEMETRY_TYPE_ADC, i)) {
+            fprintf(stderr, "telemgen: sample dropped before the frame was full\n");
+            return 1;
+        }
+    }
+
+    // full frame of one type, then mixed blocks
+    telemetry_begin(&t, 1000);
+    while (!telemetry_full(&t))
+        telemetry_add(&t, TELEMETRY_TYPE_ADC, v++);
+    send(&t);
+
+    telemetry_begin(&t, 1010);
+    telemetry_add(&t, TELEMETRY_TYPE_RPM, 1500);
+    telemetry_add(&t, TELEMETRY_TYPE_PWM, 0);
+    telemetry_add(&t, TELEMETRY_TYPE_PWM, 0xffff);
+    telemetry_add(&t, TELEMETRY_TYPE_RPM, 0x0100);
+    send(&t);
+
+    // empty sends keep the sequence number
+    for (i = 0; i < 3; i++) {
+        telemetry_begin(&t, 1020);
+        send(&t);
+    }
+
+    // a frame that does not fit into the tx ring is dropped
+    tx_free = 4;
+    telemetry_begin(&t, 1030);
+    telemetry_add(&t, TELEMETRY_TYPE_IDLE, 999);
+    send(&t);
+    tx_free = 255;
+
+    telemetry_begin(&t, 0xffff);
+    telemetry_add(&t, TELEMETRY_TYPE_DUTY, 500);
+    send(&t);
+
+    // a bit error, then a frame cut short, both after the good copy
+    last[1] ^= 0x10;
+    fwrite(last, 1, last_len, stdout);
+    fwrite(last, 1, 2, stdout);
+    putchar(0);
+
+    return 0;
+}